@@ -1,13 +1,37 @@
 #ifndef _GRAPH_CONSTANTS_
 #define _GRAPH_CONSTANTS_
 
-#define VERT_SIZE   64 * 1024 * 1024 // 64M vertices in graph_buffer
-#define EDGE_SIZE   256 * 1024 * 1024 // 256M edges in graph_buffer
+#define VERT_SIZE   64 * 1024 * 1024 // at most 64M vertices in the converter buffers, fewer when the budget is smaller
+#define EDGE_SIZE   256 * 1024 * 1024 // at most 256M edges in the converter buffers
 #define FILE_SIZE   64 * 1024 * 104 * 1024 // 16GB the maximum size of a file to store the data
-#define BLOCK_SIZE  64 * 1024 * 1024 // 64M edges in each block
-#define MEMORY_CACHE    1 * 1024 * 1024 * 1024   // 1GB memory for block cache
+#define BLOCK_SIZE  64 * 1024 * 1024 // 64MB blocks by default, `blocksize=` in MB
+#define MAX_VERTICES    (1 << 24)   // `walk_t` keeps the walk positions in 24 bits, so at most 16M vertices
+#define MEMORY_CACHE    1 * 1024 * 1024 * 1024   // 1GB budget when the available memory cannot be detected
+#define MEMORY_BUDGET_PERCENT   75          // without `memory=`, a run plans with 75% of the available memory
+#define WALK_MEMORY_SHARE       8           // the walk buffers take 1/8 of the budget, the block cache the rest
+#define PREFETCH_SHARE          4           // one cache slot in four is filled ahead, at least one
 
-#define MAX_TWALKS  4 * 1024              // one thread at most 4096 walks in memory
-#define MAX_BWALKS  12 * MAX_TWALKS       // one block at most has 12 * 4096 walks in memory
+#define PARSE_CHUNK_SIZE    64 * 1024 * 1024 // 64MB of text for each parser thread
+#define IO_CHUNK_SIZE   1 * 1024 * 1024      // 1MB for each read request issued by the io_uring driver
+#define SORT_MEMORY     1 * 1024 * 1024 * 1024   // 1GB run buffer for the external edge sort
+
+#define ITS_LINEAR_DEGREE   64              // vertices of at most 64 edges are searched linearly by the AVX2 ITS kernel
+
+#define PATH_TRECORDS   64 * 1024           // one thread buffers 64K path records before writing its fragment
+
+#define PPR_TCOUNTS     1024 * 1024         // one thread counts 1M (source, vertex) pairs before writing its visits
+
+#define SPILL_SEGMENT   1 * 1024 * 1024     // 1MB segments of the walk spill store
+#define SPILL_GROW      64                  // the spill store is extended by 64 segments at a time
+
+#define WALK_SORT_BUCKETS   64 * 1024       // the walks of a block are sorted by pos into at most 64K buckets
+
+#define STEAL_CHUNK_SHARE   8               // a thread takes 1/8 of its remaining walks per chunk
+#define STEAL_MIN_CHUNK     16              // but at least 16 walks
+
+#define PIPELINE_SPILL_JOBS 64              // the spill stage queues at most 64 walk batches
+
+#define MIN_TWALKS  256                   // one thread buffers 256 ~ 64K walks of a block before spilling them,
+#define MAX_TWALKS  64 * 1024             // the count is planned from the budget
 
 #endif
\ No newline at end of file
@@ -0,0 +1,81 @@
+#ifndef _GRAPH_THREAD_COUNTER_H_
+#define _GRAPH_THREAD_COUNTER_H_
+
+#include <assert.h>
+#include <cstdlib>
+#include <cstring>
+#include "api/types.hpp"
+
+#define CACHE_LINE_SIZE 64
+
+/**
+ * This file defines the per-thread counters used for the block statistics. Each thread owns
+ * one row of `ncounters` counters, padded to a cache line, so the walk hot path only writes
+ * its own lines and never takes a lock. The rows are reduced only when a decision needs the total.
+ */
+
+template<typename T>
+class thread_counter {
+private:
+    tid_t  nthreads;
+    size_t ncounters;
+    size_t stride;      /* row length in elements, a multiple of the cache line */
+    T     *rows;
+
+    thread_counter(const thread_counter&);
+    thread_counter& operator=(const thread_counter&);
+
+public:
+    thread_counter() { nthreads = 0, ncounters = 0, stride = 0, rows = NULL; }
+    ~thread_counter() { this->destroy(); }
+
+    void alloc(tid_t nthreads, size_t ncounters) {
+        this->destroy();
+        this->nthreads  = nthreads;
+        this->ncounters = ncounters;
+        size_t row_bytes = (ncounters * sizeof(T) + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+        this->stride = row_bytes / sizeof(T);
+        size_t bytes = (size_t)nthreads * row_bytes;
+        if(bytes == 0) bytes = CACHE_LINE_SIZE;
+
+        void *ptr = NULL;
+        int ret = posix_memalign(&ptr, CACHE_LINE_SIZE, bytes);
+        assert(ret == 0);
+        (void)ret;
+        memset(ptr, 0, bytes);
+        this->rows = (T*)ptr;
+    }
+
+    void destroy() {
+        if(rows) free(rows);
+        rows = NULL;
+        nthreads = 0, ncounters = 0, stride = 0;
+    }
+
+    T& at(tid_t t, size_t idx) {
+        assert(t < nthreads && idx < ncounters);
+        return rows[t * stride + idx];
+    }
+
+    T reduce(size_t idx) const {
+        T sum = 0;
+        for(tid_t t = 0; t < nthreads; t++) sum += rows[t * stride + idx];
+        return sum;
+    }
+
+    T reduce_max(size_t idx) const {
+        T val = 0;
+        for(tid_t t = 0; t < nthreads; t++) {
+            if(rows[t * stride + idx] > val) val = rows[t * stride + idx];
+        }
+        return val;
+    }
+
+    void reset(size_t idx) {
+        for(tid_t t = 0; t < nthreads; t++) rows[t * stride + idx] = 0;
+    }
+
+    size_t size() const { return ncounters; }
+};
+
+#endif
@@ -12,10 +12,13 @@ typedef uint16_t tid_t;   /* thread id */
 typedef uint32_t wid_t;   /* walk id */
 typedef float    real_t;  /* edge weight */
 
+/** the fields share one 64-bit word, so the record stays 16 bytes with `prev` */
 struct walk_t {
-    hid_t hop   : 16;
-    vid_t pos    : 24;   /* current walk current pos vertex */
-    vid_t source : 24;   /* walk source vertex */
+    uint64_t hop    : 16;
+    uint64_t pos    : 24;   /* current walk current pos vertex */
+    uint64_t source : 24;   /* walk source vertex */
+    vid_t prev;             /* the vertex before `pos`, equal to `pos` before the first step */
+    wid_t id;               /* walk id, keys the walk random stream */
 };
 
 #endif
@@ -0,0 +1,104 @@
+#ifndef _GRAPH_NODE2VEC_H_
+#define _GRAPH_NODE2VEC_H_
+
+#include <vector>
+#include <omp.h>
+
+#include "api/types.hpp"
+#include "util/random.hpp"
+#include "engine/walk.hpp"
+#include "engine/context.hpp"
+#include "randomwalk.hpp"
+
+/**
+ * node2vec walks with the return parameter `p` and the in-out parameter `q`, see `node2vec_context`.
+ * The previous vertex travels with the walk, its adjacency is found in the executing block, the hub
+ * block or another cached block, and only read from disk when its block is not in memory, which
+ * happens at most once per visit of a block since later steps have `prev` inside it.
+ */
+class node2vec_t : public randomwalk_t {
+protected:
+    float p, q;
+
+    /** point [adj_start, adj_end) to the adjacency of `v` in `cb`, false if `v` is not in the block */
+    static bool block_adjacency(cache_block *cb, vid_t v, vid_t *&adj_start, vid_t *&adj_end) {
+        block_t *block = cb->block;
+        if(v < block->start_vert || v >= block->start_vert + block->nverts) return false;
+        vid_t off = v - block->start_vert;
+        adj_start = cb->csr + (cb->beg_pos[off] - block->start_edge);
+        adj_end   = cb->csr + (cb->beg_pos[off + 1] - block->start_edge);
+        return true;
+    }
+
+    /** the adjacency of the previous vertex, `buf` holds it when it has to be read from disk */
+    void prev_adjacency(vid_t v, cache_block *cache, graph_walk *walk_manager, std::vector<vid_t> &buf, vid_t *&adj_start, vid_t *&adj_end) {
+        if(block_adjacency(cache, v, adj_start, adj_end)) return;
+        hub_block &hubs = walk_manager->global_blocks->hubs;
+        if(hubs.contains(v)) {
+            hubs.adjacency(v, adj_start, adj_end);
+            return;
+        }
+        if(walk_manager->global_cache) {
+            cache_block *cb = walk_manager->global_cache->find_block(walk_manager->global_blocks->get_block(v));
+            if(cb && block_adjacency(cb, v, adj_start, adj_end)) return;
+        }
+        walk_manager->global_driver->load_neighbors(v, buf);
+        adj_start = buf.data();
+        adj_end   = buf.data() + buf.size();
+    }
+
+public:
+    node2vec_t(wid_t num, hid_t hops, float _p, float _q) : randomwalk_t(num, hops, 0.0) {
+        p = _p;
+        q = _q;
+    }
+
+    void update_walk(walk_t walk, cache_block* cache, graph_walk *walk_manager) {
+        tid_t tid = omp_get_thread_num();
+        vid_t dst = walk.pos, prev = walk.prev;
+        hid_t hop = walk.hop;
+
+        rand_t rng(walk_manager->seed, walk.id, hop);
+        hub_block &hubs = walk_manager->global_blocks->hubs;
+        bool weighted = cache->prob != NULL || cache->acc != NULL;
+        std::vector<vid_t> prev_buf;
+        while(hop > 0) {
+            vid_t *adj_start, *adj_end;
+            const real_t *prob = NULL;
+            const vid_t *alias = NULL;
+            const real_t *acc = NULL;
+            if(block_adjacency(cache, dst, adj_start, adj_end)) {
+                eid_t head = adj_start - cache->csr;
+                if(cache->prob) {
+                    prob  = cache->prob + head;
+                    alias = cache->alias + head;
+                }
+                if(cache->acc) acc = cache->acc + head;
+            } else if(!weighted && hubs.contains(dst)) {
+                hubs.adjacency(dst, adj_start, adj_end);
+            } else {
+                break;
+            }
+
+            vid_t *prev_start = NULL, *prev_end = NULL;
+            if(prev != dst) prev_adjacency(prev, cache, walk_manager, prev_buf, prev_start, prev_end);
+            node2vec_context ctx(dst, prev, adj_start, adj_end, prob, alias, acc, prev_start, prev_end, p, q, walk_manager->nvertices, &rng);
+            vid_t next = choose_next(ctx);
+            /* a jump out of a dead end has no previous vertex */
+            prev = adj_start == adj_end ? next : dst;
+            dst = next;
+            if(walk_manager->paths) walk_manager->paths->record(tid, walk.id, steps - hop + 1, dst);
+            hop--;
+        }
+
+        if(hop > 0) {
+            walk.prev = prev;
+            bid_t blk = walk_manager->global_blocks->get_block(dst);
+            assert(blk < walk_manager->global_blocks->nblocks);
+            walk_manager->move_walk(walk, blk, tid, dst, hop);
+            walk_manager->set_max_hop(blk, tid, hop);
+        }
+    }
+};
+
+#endif
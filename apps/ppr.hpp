@@ -0,0 +1,207 @@
+#ifndef _GRAPH_PPR_H_
+#define _GRAPH_PPR_H_
+
+#include <string>
+#include <vector>
+#include <queue>
+#include <fstream>
+#include <algorithm>
+#include <limits>
+#include <fcntl.h>
+#include <unistd.h>
+#include <omp.h>
+
+#include "api/types.hpp"
+#include "api/constants.hpp"
+#include "util/io.hpp"
+#include "util/util.hpp"
+#include "util/count_map.hpp"
+#include "util/external_sort.hpp"
+#include "randomwalk.hpp"
+
+/** `count` visits of walks from source `source` to `vertex` */
+struct visit_t {
+    uint32_t source;    /* the source index, the vertex is `first_source + source` */
+    vid_t vertex;
+    uint32_t count;
+};
+
+struct visit_less {
+    bool operator()(const visit_t& a, const visit_t& b) const {
+        return a.source < b.source || (a.source == b.source && a.vertex < b.vertex);
+    }
+};
+
+/**
+ * Monte-Carlo personalized PageRank, the DrunkardMob setup: `walks_per_source` walks start from each
+ * of the sources `[first_source, first_source + nsources)`, each step resets to the source with the
+ * probability `reset` and every visited vertex is counted for the walk's source.
+ *
+ * The counts are kept per thread in a `count_map` keyed on (source index, vertex), which is drained
+ * to the thread's `.visit` file when it fills and after every block, so the memory is bounded whatever
+ * the number of sources. `write_topk` sorts the visit files externally, sums the counts of each pair
+ * and keeps the `k` most visited vertices of each source.
+ */
+class ppr_t : public randomwalk_t {
+public:
+    std::string base_name;
+    vid_t first_source;
+    wid_t nsources, walks_per_source;
+    tid_t nthreads;
+    std::vector<count_map> visits;         /* the counts of each thread */
+    std::vector<int> desc;                 /* the visit file of each thread */
+    std::vector<off_t> written;
+
+    /** the sources must be vertices of the `nvertices` graph and the walks must fit in `wid_t` */
+    ppr_t(const std::string& base, tid_t threads, vid_t nvertices, vid_t first, wid_t sources, wid_t per_source, hid_t hops, float reset)
+        : randomwalk_t(sources * per_source, hops, reset) {
+        if((uint64_t)first + sources > nvertices) {
+            logstream(LOG_FATAL) << "sources [" << first << ", " << (uint64_t)first + sources << ") exceed the " << nvertices << " vertices, lower firstsource= or nsources=" << std::endl;
+        }
+        if((uint64_t)sources * per_source > std::numeric_limits<wid_t>::max()) {
+            logstream(LOG_FATAL) << sources << " sources of " << per_source << " walks exceed the " << std::numeric_limits<wid_t>::max()
+                                 << " walk ids, lower nsources= or walkspersource=" << std::endl;
+        }
+        base_name = base;
+        first_source = first;
+        nsources = sources;
+        walks_per_source = per_source;
+        nthreads = threads;
+        visits.assign(nthreads, count_map(PPR_TCOUNTS));
+        written.assign(nthreads, 0);
+        desc.resize(nthreads);
+        for(tid_t t = 0; t < nthreads; t++) {
+            desc[t] = open(get_visit_name(base_name, t).c_str(), O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+            assert(desc[t] >= 0);
+        }
+    }
+
+    ~ppr_t() {
+        for(tid_t t = 0; t < nthreads; t++) {
+            close(desc[t]);
+            test_delete(get_visit_name(base_name, t));
+        }
+    }
+
+    vid_t source(wid_t idx, vid_t nvertices, rand_t &rng) {
+        assert(first_source + nsources <= nvertices);
+        return first_source + idx / walks_per_source;
+    }
+
+    void update_walk(walk_t walk, cache_block* cache, graph_walk *walk_manager) {
+        tid_t tid = omp_get_thread_num();
+        vid_t dst = walk.pos;
+        hid_t hop = walk.hop;
+        uint64_t src = walk.id / walks_per_source;
+
+        rand_t rng(walk_manager->seed, walk.id, hop);
+        hub_block &hubs = walk_manager->global_blocks->hubs;
+        bool weighted = cache->prob != NULL || cache->acc != NULL;
+        while(hop > 0) {
+            vid_t *adj_start, *adj_end;
+            eid_t head;
+            if(!locate(cache, hubs, weighted, dst, adj_start, adj_end, head)) break;
+            /* a reset or a dead end restarts from the source */
+            if(adj_start == adj_end || rng.gen_float() < teleport) dst = first_source + src;
+            else dst = step(cache, dst, adj_start, adj_end, head, 0.0, walk_manager->nvertices, rng);
+            if(walk_manager->paths) walk_manager->paths->record(tid, walk.id, steps - hop + 1, dst);
+            visits[tid].add(src << 32 | dst);
+            if(visits[tid].full()) flush(tid);
+            hop--;
+        }
+
+        if(hop > 0) {
+            bid_t blk = walk_manager->global_blocks->get_block(dst);
+            assert(blk < walk_manager->global_blocks->nblocks);
+            walk_manager->move_walk(walk, blk, tid, dst, hop);
+            walk_manager->set_max_hop(blk, tid, hop);
+        }
+    }
+
+    /** write the counts of thread `tid` to its visit file */
+    void flush(tid_t tid) {
+        std::vector<visit_t> buf;
+        buf.reserve(visits[tid].size());
+        visits[tid].drain([&buf](uint64_t key, uint32_t count) {
+            visit_t v;
+            v.source = key >> 32, v.vertex = key & 0xffffffff, v.count = count;
+            buf.push_back(v);
+        });
+        if(buf.empty()) return;
+        dump_block_range(desc[tid], buf.data(), buf.size(), written[tid]);
+        written[tid] += buf.size() * sizeof(visit_t);
+    }
+
+    void block_finished(graph_walk *walk_manager) {
+        for(tid_t t = 0; t < nthreads; t++) flush(t);
+    }
+
+    /**
+     * write the `k` most visited vertices of each source to `output`, one line `source vertex visits score`
+     * per vertex, where the score is the share of the source's visits. The source itself is not listed,
+     * and the ids are the original ones when the graph was reordered.
+     */
+    void write_topk(const std::string& output, size_t k, size_t memory) {
+        size_t nrecords = 0;
+        for(tid_t t = 0; t < nthreads; t++) {
+            flush(t);
+            nrecords += written[t] / sizeof(visit_t);
+        }
+        std::vector<vid_t> perm;
+        if(test_exists(get_perm_name(base_name))) perm = load_graph_blocks<vid_t>(get_perm_name(base_name));
+        logstream(LOG_INFO) << "merge " << nrecords << " visit records of " << nsources << " sources into " << output << std::endl;
+
+        external_sorter<visit_t, visit_less> sorter(base_name + "_visit", min_value(memory, (nrecords + 1) * sizeof(visit_t)));
+        std::vector<visit_t> chunk(PPR_TCOUNTS);
+        for(tid_t t = 0; t < nthreads; t++) {
+            size_t count = written[t] / sizeof(visit_t);
+            for(size_t off = 0; off < count; off += chunk.size()) {
+                size_t n = min_value(chunk.size(), count - off);
+                load_block_range(desc[t], chunk.data(), n, off * sizeof(visit_t));
+                for(size_t i = 0; i < n; i++) sorter.add(chunk[i]);
+            }
+        }
+
+        typedef std::pair<uint64_t, vid_t> entry_t;     /* (visits, vertex), the heap top is the least visited */
+        std::priority_queue<entry_t, std::vector<entry_t>, std::greater<entry_t> > top;
+        auto out = std::fstream(output.c_str(), std::ios::out | std::ios::trunc);
+        uint32_t curr = 0;
+        uint64_t total = 0, pending = 0;
+        vid_t vertex = 0;
+        auto push = [&]() {
+            if(pending == 0) return;
+            total += pending;
+            if(vertex != first_source + curr) {
+                top.push(entry_t(pending, vertex));
+                if(top.size() > k) top.pop();
+            }
+            pending = 0;
+        };
+        auto emit = [&]() {
+            push();
+            std::vector<entry_t> best;
+            while(!top.empty()) best.push_back(top.top()), top.pop();
+            vid_t s = first_source + curr;
+            for(auto it = best.rbegin(); it != best.rend(); it++) {
+                out << (perm.empty() ? s : perm[s]) << " " << (perm.empty() ? it->second : perm[it->second]) << " "
+                    << it->first << " " << (double)it->first / total << "\n";
+            }
+            total = 0;
+        };
+        sorter.merge([&](const visit_t& v) {
+            if(v.source != curr) {
+                emit();
+                curr = v.source;
+            } else if(v.vertex != vertex) {
+                push();
+            }
+            vertex = v.vertex;
+            pending += v.count;
+        });
+        emit();
+        out.close();
+        logstream(LOG_INFO) << "wrote the top " << k << " vertices of " << nsources << " sources to " << output << std::endl;
+    }
+};
+
+#endif
@@ -2,10 +2,9 @@
 #define _GRAPH_RANDOMWALK_H_
 
 #include <omp.h>
-#include <cstdlib>
-#include <ctime>
 
 #include "api/types.hpp"
+#include "util/random.hpp"
 #include "engine/walk.hpp"
 #include "engine/context.hpp"
 
@@ -15,25 +14,74 @@ protected:
     hid_t steps;        /* the number of hops */
     float teleport;   /* the probability teleport to source vertex */
 
+    /**
+     * point [adj_start, adj_end) to the adjacency of `dst` in the executing block, `head` to its first
+     * edge, or in the hub block for unweighted walks. False if the walk has to move to another block.
+     */
+    bool locate(cache_block *cache, hub_block &hubs, bool weighted, vid_t dst, vid_t *&adj_start, vid_t *&adj_end, eid_t &head) {
+        block_t *block = cache->block;
+        if(dst >= block->start_vert && dst < block->start_vert + block->nverts) {
+            vid_t off = dst - block->start_vert;
+            head      = cache->beg_pos[off] - block->start_edge;
+            adj_start = cache->csr + head;
+            adj_end   = cache->csr + (cache->beg_pos[off + 1] - block->start_edge);
+            return true;
+        }
+        if(!weighted && hubs.contains(dst)) {
+            hubs.adjacency(dst, adj_start, adj_end);
+            head = 0;
+            return true;
+        }
+        return false;
+    }
+
+    /** the first-order step from `dst`, by the accumulated weights or the alias tables when the block has them */
+    vid_t step(cache_block *cache, vid_t dst, vid_t *adj_start, vid_t *adj_end, eid_t head, float prob, vid_t nvertices, rand_t &rng) {
+        if(cache->acc) {
+            its_context ctx(dst, adj_start, adj_end, cache->acc + head, prob, nvertices, &rng);
+            return choose_next(ctx);
+        } else if(cache->prob) {
+            alias_context ctx(dst, adj_start, adj_end, cache->prob + head, cache->alias + head, prob, nvertices, &rng);
+            return choose_next(ctx);
+        } else {
+            graph_context ctx(dst, adj_start, adj_end, prob, nvertices, &rng);
+            return choose_next(ctx);
+        }
+    }
+
 public:
     randomwalk_t(wid_t num, hid_t hops, float prob) { 
         numsources = num;
         steps = hops;
         teleport = prob;
     }
+    virtual ~randomwalk_t() { }
+
+    /** the start vertex of walk `idx`, a uniform draw by default */
+    virtual vid_t source(wid_t idx, vid_t nvertices, rand_t &rng) {
+        return rng.gen(nvertices);
+    }
+
+    /** called after the walks of a block are executed */
+    virtual void block_finished(graph_walk *walk_manager) { }
 
-    void update_walk(walk_t walk, cache_block* cache, graph_walk *walk_manager) {
+    virtual void update_walk(walk_t walk, cache_block* cache, graph_walk *walk_manager) {
         tid_t tid = omp_get_thread_num();
         vid_t dst = walk.pos;
         hid_t hop = walk.hop;
 
-        srand(time(0));
-        vid_t start_vert = cache->block->start_vert, end_vert = cache->block->start_vert + cache->block->nverts;
-        while(dst >= start_vert && dst < end_vert && hop > 0) {
-            vid_t off = dst - start_vert;
-            eid_t adj_head = cache->beg_pos[off] - cache->block->start_edge, adj_tail = cache->beg_pos[off + 1] - cache->block->start_edge;
-            graph_context ctx(dst, cache->csr + adj_head, cache->csr + adj_tail, teleport, walk_manager->nvertices);
-            dst = choose_next(ctx);
+        /* the walk stream is keyed on (seed, walk id, hop), independent of the executing thread */
+        rand_t rng(walk_manager->seed, walk.id, hop);
+        hub_block &hubs = walk_manager->global_blocks->hubs;
+        /* the block carries alias tables or accumulated weights when the engine runs weighted, the hub block has neither */
+        bool weighted = cache->prob != NULL || cache->acc != NULL;
+        while(hop > 0) {
+            vid_t *adj_start, *adj_end;
+            eid_t head;
+            if(!locate(cache, hubs, weighted, dst, adj_start, adj_end, head)) break;
+            walk.prev = dst;
+            dst = step(cache, dst, adj_start, adj_end, head, teleport, walk_manager->nvertices, rng);
+            if(walk_manager->paths) walk_manager->paths->record(tid, walk.id, steps - hop + 1, dst);
             hop--;
         }
 
@@ -41,7 +89,7 @@ public:
             bid_t blk = walk_manager->global_blocks->get_block(dst);
             assert(blk < walk_manager->global_blocks->nblocks);
             walk_manager->move_walk(walk, blk, tid, dst, hop);
-            walk_manager->set_max_hop(blk, hop);
+            walk_manager->set_max_hop(blk, tid, hop);
         }
     }
 
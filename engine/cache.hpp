@@ -2,13 +2,13 @@
 #define _GRAPH_CACHE_H_
 
 #include <vector>
+#include <algorithm>
 #include <cstdlib>
 #include <cassert>
-#include <mutex>
-#include <memory>
 
 #include "api/constants.hpp"
 #include "api/types.hpp"
+#include "api/thread_counter.hpp"
 #include "util/util.hpp"
 #include "util/io.hpp"
 #include "config.hpp"
@@ -24,10 +24,11 @@
  * `USED`       : the block is finished runing, but still in memory
  * `ACTIVE`     : the block is in memroy, but not use
  * `INACTIVE`   : the block is in disk
+ * `LOADING`    : the block is being prefetched into a cache slot in background
  */
 
 enum block_state {
-    USING = 1, USED, ACTIVE, INACTIVE
+    USING = 1, USED, ACTIVE, INACTIVE, LOADING
 };
 
 class block_t {
@@ -37,15 +38,12 @@ public:
     eid_t start_edge, nedges;           /* block start edge and the number of edges in this block */
 
     block_state status;                 /* indicate the state of this block */
-    rank_t rank;                        /* record the block rank */
-    std::shared_ptr<std::mutex> mtx;    /* mutex for safe update the rank */
 
     block_t() {
         blk = 0;
         start_vert = nverts = 0;
         start_edge = nedges = 0;
         status  = INACTIVE;
-        mtx = std::make_shared<std::mutex>();
     }
 
     block_t& operator=(const block_t& other) {
@@ -56,7 +54,6 @@ public:
             this->start_edge = other.start_edge;
             this->nedges     = other.nedges;
             this->status     = other.status;
-            this->rank       = other.rank;
         }
         return *this;
     }
@@ -69,18 +66,29 @@ public:
     eid_t *beg_pos;                 
     vid_t *degree;
     vid_t *csr;
+    real_t *prob;                   /* the alias table of each edge, only loaded for weighted walks */
+    vid_t *alias;
+    real_t *acc;                    /* the accumulated edge weights, only loaded for ITS sampling */
+    bool mapped;                    /* `beg_pos` and `csr` point into a file mapping, not owned */
 
     cache_block() {
         block   = NULL;
         beg_pos = NULL;
         degree  = NULL;
         csr     = NULL;
+        prob    = NULL;
+        alias   = NULL;
+        acc     = NULL;
+        mapped  = false;
     }
 
     ~cache_block() {
-        if(beg_pos) free(beg_pos);
+        if(beg_pos && !mapped) free(beg_pos);
         if(degree)  free(degree);
-        if(csr)     free(csr);
+        if(csr && !mapped)     free(csr);
+        if(prob)    free(prob);
+        if(alias)   free(alias);
+        if(acc)     free(acc);
     }
 };
 
@@ -89,6 +97,10 @@ void swap(cache_block& cb1, cache_block& cb2) {
     eid_t *tbeg_pos = cb2.beg_pos;
     vid_t *tdegree  = cb2.degree;
     vid_t *tcsr     = cb2.csr;
+    bool tmapped    = cb2.mapped;
+    std::swap(cb1.prob, cb2.prob);
+    std::swap(cb1.alias, cb2.alias);
+    std::swap(cb1.acc, cb2.acc);
     cb2.block = cb1.block;
     cb2.beg_pos = cb1.beg_pos;
     cb2.degree = cb1.degree;
@@ -97,12 +109,66 @@ void swap(cache_block& cb1, cache_block& cb2) {
     cb1.beg_pos = tbeg_pos;
     cb1.degree = tdegree;
     cb1.csr = tcsr;
+    cb2.mapped = cb1.mapped;
+    cb1.mapped = tmapped;
 }
 
+/**
+ * The hub block holds the adjacency of the vertices of the highest in-degree, written by the preprocessor
+ * with `hubs=K`. It is loaded once and pinned for the whole run, a walk arriving at a hub keeps stepping
+ * on it instead of moving to the hub's block. Its memory is taken from the block cache.
+ */
+class hub_block {
+public:
+    vid_t nhubs;
+    std::vector<vid_t> ids;         /* the sorted hub vertices */
+    std::vector<eid_t> beg_pos;     /* the adjacency of `ids[i]` is `csr[beg_pos[i], beg_pos[i+1])` */
+    std::vector<vid_t> csr;
+    std::vector<uint64_t> bitmap;   /* one bit per vertex, set for the hubs */
+
+    hub_block() {
+        nhubs = 0;
+    }
+
+    /** load the hub block of `base_name` if the preprocessor wrote one */
+    void load(const std::string& base_name, vid_t nvertices) {
+        std::string hub_name = get_hub_name(base_name);
+        if(!test_exists(hub_name)) return;
+        ids     = load_graph_blocks<vid_t>(hub_name);
+        beg_pos = load_graph_blocks<eid_t>(get_hub_beg_pos_name(base_name));
+        nhubs   = ids.size();
+        if(nhubs == 0) return;
+        if(beg_pos.back() > 0) csr = load_graph_blocks<vid_t>(get_hub_csr_name(base_name));
+        assert(beg_pos.size() == (size_t)nhubs + 1 && csr.size() == beg_pos.back());
+
+        bitmap.assign((nvertices + 63) / 64, 0);
+        for(vid_t v : ids) bitmap[v >> 6] |= 1ULL << (v & 63);
+        logstream(LOG_INFO) << "hub block : " << nhubs << " hubs, " << csr.size() << " edges, " << memory_size() << " bytes pinned" << std::endl;
+    }
+
+    bool contains(vid_t v) const {
+        return nhubs > 0 && ((bitmap[v >> 6] >> (v & 63)) & 1);
+    }
+
+    /** the adjacency of the hub `v` */
+    void adjacency(vid_t v, vid_t *&adj_start, vid_t *&adj_end) {
+        vid_t h = std::lower_bound(ids.begin(), ids.end(), v) - ids.begin();
+        adj_start = csr.data() + beg_pos[h];
+        adj_end   = csr.data() + beg_pos[h + 1];
+    }
+
+    size_t memory_size() const {
+        return ids.size() * sizeof(vid_t) + beg_pos.size() * sizeof(eid_t) + csr.size() * sizeof(vid_t) + bitmap.size() * sizeof(uint64_t);
+    }
+};
+
 class graph_block {
 public:
     bid_t nblocks;
     std::vector<block_t> blocks;
+    block_index index;              /* vertex to block lookup */
+    thread_counter<rank_t> ranks;   /* per-thread block rank, reduced on schedule */
+    hub_block hubs;                 /* the pinned hub vertices */
 
     graph_block(graph_config* conf) {
         std::string vert_block_name = get_vert_blocks_name(conf->base_name, conf->blocksize);
@@ -113,6 +179,9 @@ public:
 
         nblocks = vblocks.size() - 1;
         blocks.resize(nblocks);
+        index.build(vblocks);
+        ranks.alloc(conf->nthreads, nblocks);
+        hubs.load(conf->base_name, conf->nvertices);
 
         for(bid_t blk = 0; blk < nblocks; blk++) { 
             blocks[blk].blk = blk;
@@ -121,7 +190,6 @@ public:
             blocks[blk].start_edge = eblocks[blk];
             blocks[blk].nedges     = eblocks[blk+1] - eblocks[blk];
             blocks[blk].status     = INACTIVE;
-            blocks[blk].rank       = 0;
 
             logstream(LOG_INFO) << "blk [ " << blk << " ] : vert = [ " << blocks[blk].start_vert << ", " << blocks[blk].start_vert + blocks[blk].nverts << " ], csr = [ ";
             logstream(LOG_INFO) << blocks[blk].start_edge << ", " << blocks[blk].start_edge + blocks[blk].nedges << " ]" << std::endl;
@@ -135,31 +203,64 @@ public:
 
     void reset_rank(bid_t blk) {
         assert(blk < nblocks);
-        blocks[blk].rank = 0;
+        ranks.reset(blk);
     }
 
-    void update_rank(vid_t dst) {
-        bid_t blk = get_block(dst);
-        std::lock_guard<std::mutex> lock(*blocks[blk].mtx);
-        blocks[blk].rank += 1;
+    void update_rank(bid_t blk, tid_t t) {
+        ranks.at(t, blk) += 1;
     }
 
-    bid_t get_block(vid_t v) {
-        bid_t blk = 0;
-        for(; blk < nblocks; blk++) { 
-            if(v < blocks[blk].start_vert + blocks[blk].nverts) return blk;
-        }
-        return nblocks;
+    rank_t rank(bid_t blk) const {
+        return ranks.reduce(blk);
+    }
+
+    bid_t get_block(vid_t v) const {
+        return index.get_block(v);
     }
 };
 
+/** the memory of one cache slot, the alias tables take two more words per edge, the accumulated weights one */
+inline size_t block_memory_size(const graph_config& conf) {
+    if(!conf.weighted) return conf.blocksize;
+    return conf.its ? conf.blocksize * 2 : conf.blocksize * 3;
+}
+
+/**
+ * split the memory budget of `conf` between the walk buffers, the block cache and the prefetch slots.
+ * The walk buffers of every (block, thread) pair take up to `1 / WALK_MEMORY_SHARE` of the budget,
+ * between `MIN_TWALKS` and `MAX_TWALKS` walks each, the cache takes the rest with the `pinned` hub block,
+ * and `1 / PREFETCH_SHARE` of its slots are filled ahead. A budget without room for `MIN_TWALKS` walks,
+ * one slot and the hubs is fatal.
+ */
+inline void plan_memory(graph_config& conf, bid_t nblocks, size_t pinned) {
+    size_t buffers = (size_t)nblocks * conf.nthreads * sizeof(walk_t);
+    size_t slot = block_memory_size(conf);
+
+    /* the walk buffers give way to one cache slot and the hubs, down to `MIN_TWALKS` walks */
+    size_t least = buffers * MIN_TWALKS + slot + pinned;
+    if(conf.memory < least) {
+        logstream(LOG_FATAL) << "the memory budget of " << (conf.memory >> 20) << "MB cannot hold the walk buffers, one block and the hubs, raise memory= to at least "
+                             << ((least + (1 << 20) - 1) >> 20) << "MB" << std::endl;
+    }
+    conf.twalks = min_value(max_value(conf.memory / WALK_MEMORY_SHARE / buffers, (size_t)MIN_TWALKS), (size_t)MAX_TWALKS);
+    conf.twalks = min_value(conf.twalks, (conf.memory - slot - pinned) / buffers);
+    size_t walk_memory = buffers * conf.twalks;
+    conf.cache_memory = conf.memory - walk_memory;
+
+    size_t nslots = min_value((conf.cache_memory > pinned ? conf.cache_memory - pinned : 0) / slot, (size_t)nblocks);
+    conf.prefetch_depth = nslots < 2 ? 0 : max_value(nslots / PREFETCH_SHARE, (size_t)1);
+    logstream(LOG_INFO) << "memory plan : " << (conf.memory >> 20) << "MB, block cache " << (conf.cache_memory >> 20) << "MB in " << nslots << " slots of "
+                        << (slot >> 20) << "MB with " << (pinned >> 20) << "MB of hubs, walk buffers " << (walk_memory >> 20) << "MB of " << conf.twalks
+                        << " walks per block and thread, prefetch depth " << conf.prefetch_depth << std::endl;
+}
+
 class graph_cache {
 public:
     bid_t ncblock;                  /* number of cache blocks */
     std::vector<cache_block> cache_blocks; /* the cached blocks */
 
-    graph_cache(bid_t nblocks, size_t blocksize = BLOCK_SIZE) { 
-        setup(nblocks, blocksize);
+    graph_cache(bid_t nblocks, size_t blocksize = BLOCK_SIZE, size_t pinned = 0, size_t memory = MEMORY_CACHE) { 
+        setup(nblocks, blocksize, pinned, memory);
     }
 
     cache_block& operator[](size_t index) {
@@ -172,12 +273,26 @@ public:
         return cache_blocks[index];
     }
 
-    void setup(bid_t nblocks, size_t blocksize = BLOCK_SIZE) {
-        ncblock = min_value(nblocks, MEMORY_CACHE / blocksize);
+    /** `pinned` bytes of the cache `memory` are held by the hub block */
+    void setup(bid_t nblocks, size_t blocksize = BLOCK_SIZE, size_t pinned = 0, size_t memory = MEMORY_CACHE) {
+        memory = memory > pinned ? memory - pinned : 0;
+        ncblock = min_value(nblocks, memory / blocksize);
+        if(ncblock == 0) {
+            logstream(LOG_ERROR) << "The hub block of " << pinned << " bytes leaves no room for a block in the cache" << std::endl;
+        }
         assert(ncblock > 0);
         cache_blocks.resize(ncblock);
     }
 
+    /** the cache block holding `blk` ready for reads, NULL if it is not cached or still loading */
+    cache_block *find_block(bid_t blk) {
+        for(bid_t p = 0; p < ncblock; p++) {
+            block_t *b = cache_blocks[p].block;
+            if(b != NULL && b->blk == blk && b->status != LOADING && b->status != INACTIVE) return &cache_blocks[p];
+        }
+        return NULL;
+    }
+
     bool test_block_cached(bid_t blk, bid_t &exec_blk) {
         for(bid_t p = 0; p < ncblock; p++) {
             if(cache_blocks[p].block != NULL && cache_blocks[p].block->blk == blk) {
@@ -17,6 +17,21 @@ struct graph_config {
 
     vid_t nvertices;
     eid_t nedges;
+
+    uint64_t seed;      /* the run seed, the same seed reproduces the same walks */
+    unsigned io_depth;  /* the number of in-flight requests of the asynchronous io driver */
+    bool weighted;      /* load the `.pb` and `.as` alias tables with the blocks */
+    bool its;           /* weighted walks sample by inverse transform over `.acc` instead of the alias tables */
+    bool pipeline;      /* load and spill the walks in background stages, see `walk_pipeline` */
+    bool multi_block;   /* run the walks of all cached blocks together, handing off walks between them in memory */
+    bool steal;         /* execute the walks of a block with work stealing instead of a static split */
+    bool sort_walks;    /* sort the loaded walks of a block by pos before executing them */
+    bool pack_walks;    /* encode the spilled walk batches with `walk_codec` instead of writing them raw */
+
+    size_t memory;          /* the memory budget in bytes, split by `plan_memory` into the fields below */
+    size_t cache_memory;    /* the block cache, the hub block included */
+    wid_t twalks;           /* the walks one thread buffers for a block before spilling them */
+    bid_t prefetch_depth;   /* the blocks loaded ahead into spare cache slots */
 };
 
 #endif
\ No newline at end of file
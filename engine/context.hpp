@@ -1,9 +1,13 @@
 #ifndef _GRAPH_CONTEXT_H_
 #define _GRAPH_CONTEXT_H_
 
-#include <cstdlib>
-#include <ctime>
+#include <algorithm>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 #include "api/types.hpp"
+#include "api/constants.hpp"
+#include "util/random.hpp"
 #include "logger/logger.hpp"
 
 /** graph context
@@ -25,22 +29,180 @@ public:
     vid_t *adj_start, *adj_end;
     float teleport;
     vid_t nvertices;
+    rand_t *rng;
 
-    graph_context(vid_t _pos, vid_t *_adj_start, vid_t *_adj_end, float _teleport, vid_t _nvertices) {
+    graph_context(vid_t _pos, vid_t *_adj_start, vid_t *_adj_end, float _teleport, vid_t _nvertices, rand_t *_rng) {
         this->pos = _pos;
         this->adj_start = _adj_start;
         this->adj_end = _adj_end;
         this->teleport = _teleport;
         this->nvertices = _nvertices;
+        this->rng = _rng;
     }
 
     vid_t transition() { 
         eid_t deg = (eid_t)(adj_end - adj_start);
-        if(deg > 0 && (float)rand() / RAND_MAX > teleport) {
-            vid_t off = (vid_t)rand() % deg;
+        if(deg > 0 && rng->gen_float() > teleport) {
+            eid_t off = rng->gen(deg);
             return this->adj_start[off];
         }else {
-            return rand() % nvertices;
+            return rng->gen(nvertices);
+        }
+    }
+};
+
+/** draw an edge offset of a vertex of degree `deg` from its alias table */
+inline eid_t alias_sample(const real_t *prob, const vid_t *alias, eid_t deg, rand_t *rng) {
+    eid_t off = rng->gen(deg);
+    return rng->gen_float() < prob[off] ? off : alias[off];
+}
+
+/** the weighted first-order transition, an edge is drawn from the alias table of `pos` in O(1) */
+class alias_context : public context {
+public:
+    vid_t pos;
+    vid_t *adj_start, *adj_end;
+    const real_t *prob;
+    const vid_t *alias;
+    float teleport;
+    vid_t nvertices;
+    rand_t *rng;
+
+    alias_context(vid_t _pos, vid_t *_adj_start, vid_t *_adj_end, const real_t *_prob, const vid_t *_alias, float _teleport, vid_t _nvertices, rand_t *_rng) {
+        pos = _pos;
+        adj_start = _adj_start, adj_end = _adj_end;
+        prob = _prob, alias = _alias;
+        teleport = _teleport;
+        nvertices = _nvertices;
+        rng = _rng;
+    }
+
+    vid_t transition() {
+        eid_t deg = (eid_t)(adj_end - adj_start);
+        if(deg > 0 && rng->gen_float() > teleport) {
+            return adj_start[alias_sample(prob, alias, deg, rng)];
+        } else {
+            return rng->gen(nvertices);
+        }
+    }
+};
+
+/**
+ * the number of prefix sums `acc[0, deg)` not above `u`, which is the edge an inverse transform draw of
+ * `u` lands on. Short lists are compared eight at a time with AVX2 when it is enabled, the others are
+ * searched by a binary search whose halving is a conditional move rather than a branch.
+ */
+inline eid_t its_search(const real_t *acc, eid_t deg, real_t u) {
+#ifdef __AVX2__
+    eid_t linear = ITS_LINEAR_DEGREE;
+    if(deg <= linear) {
+        __m256 key = _mm256_set1_ps(u);
+        eid_t cnt = 0, i = 0;
+        for(; i + 8 <= deg; i += 8) {
+            __m256 sums = _mm256_loadu_ps(acc + i);
+            cnt += __builtin_popcount(_mm256_movemask_ps(_mm256_cmp_ps(sums, key, _CMP_LE_OQ)));
+        }
+        for(; i < deg; i++) cnt += acc[i] <= u;
+        return cnt;
+    }
+#endif
+    const real_t *base = acc;
+    eid_t n = deg;
+    while(n > 1) {
+        eid_t half = n / 2;
+        /* both possible next probes are fetched, the loads overlap instead of waiting on the compare */
+        __builtin_prefetch(base + half / 2);
+        __builtin_prefetch(base + half + half / 2);
+        base = base[half] <= u ? base + half : base;
+        n -= half;
+    }
+    return (base - acc) + (*base <= u);
+}
+
+/** draw an edge offset of a vertex of degree `deg` by inverse transform over its accumulated weights */
+inline eid_t its_sample(const real_t *acc, eid_t deg, rand_t *rng) {
+    real_t total = acc[deg - 1];
+    if(!(total > 0.0f)) return rng->gen(deg);
+    eid_t off = its_search(acc, deg, rng->gen_float() * total);
+    return std::min(off, deg - 1);
+}
+
+/** the weighted first-order transition over the accumulated weights, for weights that change without rebuilding alias tables */
+class its_context : public context {
+public:
+    vid_t pos;
+    vid_t *adj_start, *adj_end;
+    const real_t *acc;
+    float teleport;
+    vid_t nvertices;
+    rand_t *rng;
+
+    its_context(vid_t _pos, vid_t *_adj_start, vid_t *_adj_end, const real_t *_acc, float _teleport, vid_t _nvertices, rand_t *_rng) {
+        pos = _pos;
+        adj_start = _adj_start, adj_end = _adj_end;
+        acc = _acc;
+        teleport = _teleport;
+        nvertices = _nvertices;
+        rng = _rng;
+    }
+
+    vid_t transition() {
+        eid_t deg = (eid_t)(adj_end - adj_start);
+        if(deg > 0 && rng->gen_float() > teleport) {
+            return adj_start[its_sample(acc, deg, rng)];
+        } else {
+            return rng->gen(nvertices);
+        }
+    }
+};
+
+/** test whether the sorted adjacency [adj_start, adj_end) contains `v` */
+inline bool adjacent(const vid_t *adj_start, const vid_t *adj_end, vid_t v) {
+    return std::binary_search(adj_start, adj_end, v);
+}
+
+/**
+ * The node2vec transition, KnightKing style: a candidate is drawn from the first-order distribution,
+ * uniform, by the alias table or by the accumulated weights, and accepted with `f / max f`, where `f` is `1 / p` for a return to
+ * `prev`, `1` for a neighbor of `prev` and `1 / q` otherwise. The adjacency of `prev` is only searched
+ * for candidates that need it.
+ */
+class node2vec_context : public context {
+public:
+    vid_t pos, prev;
+    vid_t *adj_start, *adj_end;
+    const real_t *prob;                 /* NULL unless sampled by the alias table */
+    const vid_t *alias;
+    const real_t *acc;                  /* NULL unless sampled by inverse transform */
+    const vid_t *prev_start, *prev_end; /* the sorted adjacency of `prev` */
+    float f_return, f_in, f_out;        /* the acceptance probabilities, divided by their maximum */
+    vid_t nvertices;
+    rand_t *rng;
+
+    node2vec_context(vid_t _pos, vid_t _prev, vid_t *_adj_start, vid_t *_adj_end, const real_t *_prob, const vid_t *_alias,
+                     const real_t *_acc, const vid_t *_prev_start, const vid_t *_prev_end, float p, float q, vid_t _nvertices, rand_t *_rng) {
+        pos = _pos, prev = _prev;
+        adj_start = _adj_start, adj_end = _adj_end;
+        prob = _prob, alias = _alias;
+        acc = _acc;
+        prev_start = _prev_start, prev_end = _prev_end;
+        float max_f = std::max(std::max(1.0f / p, 1.0f), 1.0f / q);
+        f_return = 1.0f / p / max_f;
+        f_in     = 1.0f / max_f;
+        f_out    = 1.0f / q / max_f;
+        nvertices = _nvertices;
+        rng = _rng;
+    }
+
+    vid_t transition() {
+        eid_t deg = (eid_t)(adj_end - adj_start);
+        if(deg == 0) return rng->gen(nvertices);
+        while(true) {
+            eid_t off = prob ? alias_sample(prob, alias, deg, rng) : (acc ? its_sample(acc, deg, rng) : rng->gen(deg));
+            vid_t next = adj_start[off];
+            if(prev == pos) return next;
+            float f = next == prev ? f_return : (adjacent(prev_start, prev_end, next) ? f_in : f_out);
+            if(f >= 1.0f || rng->gen_float() < f) return next;
         }
     }
 };
@@ -1,19 +1,70 @@
 #ifndef _GRAPH_DRIVER_H_
 #define _GRAPH_DRIVER_H_
 
+#include <sys/mman.h>
+#include <cerrno>
+#include <cstring>
+#include <mutex>
 #include "cache.hpp"
+#include "config.hpp"
 #include "util/io.hpp"
+#include "util/uring.hpp"
+#include "util/codec.hpp"
+#include "util/timer.hpp"
 #include "api/graph_buffer.hpp"
 #include "api/types.hpp"
 
 /** graph_driver
  * This file contribute to define the operations of how to read from disk
  * or how to write graph data into disk
+ *
+ * `graph_driver` : copies the block ranges into the cache block buffers with `pread`
+ * `mmap_driver`  : maps the csr files, the cache block points straight into the mapping
+ * `uring_driver` : splits block loads into many parallel io_uring reads, and batches the walk
+ *                  spills of all threads into asynchronous io_uring writes
+ * `compressed_driver` : reads the group varint encoded blocks of `.zcsr` and decodes them in memory
  */
 
 class graph_driver {
+protected:
+    int begdesc, csrdesc;           /* for the adjacency of single vertices */
+    int probdesc, aliasdesc;        /* the alias tables, open for weighted walks */
+    int accdesc;                    /* the accumulated weights, open for weighted walks sampled by ITS */
+
+    void open_files(graph_config *conf) {
+        begdesc  = open(get_beg_pos_name(conf->base_name, conf->fnum).c_str(), O_RDONLY);
+        csrdesc  = open(get_csr_name(conf->base_name, conf->fnum).c_str(), O_RDONLY);
+        probdesc = aliasdesc = accdesc = -1;
+        if(conf->weighted && conf->its) {
+            accdesc = open(get_accumulate_name(conf->base_name, conf->fnum).c_str(), O_RDONLY);
+            if(accdesc < 0) {
+                logstream(LOG_ERROR) << "ITS sampling needs the accumulated weights, preprocess the graph with weighted=1" << std::endl;
+                assert(false);
+            }
+        } else if(conf->weighted) {
+            probdesc  = open(get_prob_name(conf->base_name, conf->fnum).c_str(), O_RDONLY);
+            aliasdesc = open(get_alias_name(conf->base_name, conf->fnum).c_str(), O_RDONLY);
+            if(probdesc < 0 || aliasdesc < 0) {
+                logstream(LOG_ERROR) << "weighted walks need the alias tables, preprocess the graph with weighted=1" << std::endl;
+                assert(false);
+            }
+        }
+    }
+
 public:
-    graph_driver() { }
+    graph_driver() {
+        begdesc = csrdesc = probdesc = aliasdesc = accdesc = -1;
+    }
+    graph_driver(graph_config *conf) {
+        open_files(conf);
+    }
+    virtual ~graph_driver() {
+        if(begdesc >= 0)   close(begdesc);
+        if(csrdesc >= 0)   close(csrdesc);
+        if(probdesc >= 0)  close(probdesc);
+        if(aliasdesc >= 0) close(aliasdesc);
+        if(accdesc >= 0)   close(accdesc);
+    }
     
     void load_block_vertex(int fd, eid_t *buf, const block_t &block) { 
         load_block_range(fd, buf, block.nverts + 1, block.start_vert * sizeof(eid_t));
@@ -27,15 +78,411 @@ public:
         load_block_range(fd, buf, block.nedges, block.start_edge * sizeof(vid_t));
     }
 
-    void load_walk(int fd, size_t cnt, graph_buffer<walk_t> &walks) {
-        load_block_range(fd, walks.buffer_begin(), cnt, 0);
-        walks.set_size(cnt);
+    /** allocate the cache block buffers, then read the block vertex and edge ranges into them */
+    virtual void load_block(int vertdesc, int edgedesc, cache_block &cb, const block_t &block) {
+        if(cb.mapped) {
+            cb.beg_pos = NULL;
+            cb.csr     = NULL;
+            cb.mapped  = false;
+        }
+        cb.beg_pos = (eid_t*)realloc(cb.beg_pos, (block.nverts + 1) * sizeof(eid_t));
+        cb.csr     = (vid_t*)realloc(cb.csr, block.nedges * sizeof(vid_t));
+        load_block_vertex(vertdesc, cb.beg_pos, block);
+        load_block_edge(edgedesc, cb.csr, block);
+        load_block_weights(cb, block);
+    }
+
+    /** read the alias tables or the accumulated weights of the block when the walks are weighted */
+    virtual void load_block_weights(cache_block &cb, const block_t &block) {
+        if(accdesc >= 0) {
+            cb.acc = (real_t*)realloc(cb.acc, max_value(block.nedges, 1) * sizeof(real_t));
+            load_block_range(accdesc, cb.acc, block.nedges, block.start_edge * sizeof(real_t));
+        }
+        if(probdesc < 0) return;
+        cb.prob  = (real_t*)realloc(cb.prob, max_value(block.nedges, 1) * sizeof(real_t));
+        cb.alias = (vid_t*)realloc(cb.alias, max_value(block.nedges, 1) * sizeof(vid_t));
+        load_block_range(probdesc, cb.prob, block.nedges, block.start_edge * sizeof(real_t));
+        load_block_range(aliasdesc, cb.alias, block.nedges, block.start_edge * sizeof(vid_t));
+    }
+
+    /** the cache block is evicted, the buffers are kept for the next load */
+    virtual void unload_block(cache_block &cb) { }
+
+    /** read the adjacency of `v` from disk, for a vertex whose block is not cached */
+    virtual void load_neighbors(vid_t v, std::vector<vid_t> &adj) {
+        assert(begdesc >= 0 && csrdesc >= 0);
+        eid_t range[2];
+        load_block_range(begdesc, range, 2, (off_t)v * sizeof(eid_t));
+        adj.resize(range[1] - range[0]);
+        load_block_range(csrdesc, adj.data(), adj.size(), range[0] * sizeof(vid_t));
     }
 
-    void dump_walk(int fd, graph_buffer<walk_t> &walks) {
-        dump_block_range(fd, walks.buffer_begin(), walks.size(), 0);
-        walks.set_size(0);
+    /** read `bytes` of spilled walks at `off` of the spill store */
+    virtual void load_walk(int fd, void *buf, size_t bytes, off_t off) {
+        load_block_range(fd, (char*)buf, bytes, off);
+    }
+
+    /** write `bytes` of walks at `off` of the spill store, `buf` can be reused on return */
+    virtual void dump_walk(int fd, const void *buf, size_t bytes, off_t off) {
+        dump_block_range(fd, (char*)buf, bytes, off);
     }
 };
 
+class mmap_driver : public graph_driver {
+private:
+    eid_t *beg_map;
+    vid_t *csr_map;
+    size_t beg_len, csr_len;
+    size_t page_size;
+
+    void *map_file(const std::string& name, size_t &len) {
+        int fd = open(name.c_str(), O_RDONLY);
+        assert(fd >= 0);
+        len = lseek(fd, 0, SEEK_END);
+        void *ptr = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+        assert(ptr != MAP_FAILED);
+        close(fd);
+        /* walks jump around inside a block, so kernel readahead is left to the explicit advice */
+        madvise(ptr, len, MADV_RANDOM);
+        return ptr;
+    }
+
+    /** apply `advice` to the pages covering [ptr, ptr + len) */
+    void advise(void *ptr, size_t len, int advice) {
+        uintptr_t start = (uintptr_t)ptr & ~(page_size - 1);
+        uintptr_t end = (uintptr_t)ptr + len;
+        madvise((void*)start, end - start, advice);
+    }
+
+public:
+    mmap_driver(graph_config *conf) : graph_driver(conf) {
+        page_size = sysconf(_SC_PAGESIZE);
+        beg_map = (eid_t*)map_file(get_beg_pos_name(conf->base_name, conf->fnum), beg_len);
+        csr_map = (vid_t*)map_file(get_csr_name(conf->base_name, conf->fnum), csr_len);
+    }
+
+    ~mmap_driver() {
+        munmap(beg_map, beg_len);
+        munmap(csr_map, csr_len);
+    }
+
+    /** point the cache block into the mapping and ask the kernel to read the block ranges ahead */
+    void load_block(int vertdesc, int edgedesc, cache_block &cb, const block_t &block) {
+        if(!cb.mapped) {
+            if(cb.beg_pos) free(cb.beg_pos);
+            if(cb.csr)     free(cb.csr);
+            cb.mapped = true;
+        }
+        cb.beg_pos = beg_map + block.start_vert;
+        cb.csr     = csr_map + block.start_edge;
+        advise(cb.beg_pos, (block.nverts + 1) * sizeof(eid_t), MADV_WILLNEED);
+        advise(cb.csr, block.nedges * sizeof(vid_t), MADV_WILLNEED);
+        load_block_weights(cb, block);
+    }
+
+    void load_neighbors(vid_t v, std::vector<vid_t> &adj) {
+        adj.assign(csr_map + beg_map[v], csr_map + beg_map[v + 1]);
+    }
+
+    /** the pages stay in the page cache, only the mapping of the evicted block is dropped */
+    void unload_block(cache_block &cb) {
+        if(!cb.mapped || cb.block == NULL) return;
+        advise(cb.beg_pos, (cb.block->nverts + 1) * sizeof(eid_t), MADV_DONTNEED);
+        advise(cb.csr, cb.block->nedges * sizeof(vid_t), MADV_DONTNEED);
+    }
+};
+
+#ifdef HAVE_IO_URING
+class uring_driver : public graph_driver {
+private:
+    /** one in-flight request, the remainder is resubmitted after a short read or write */
+    struct request_t {
+        int fd;
+        char *buf;
+        size_t cap;                     /* the staging buffer capacity, only used by spills */
+        size_t len, done;
+        off_t off;
+        bool busy;
+    };
+
+    bool ready;
+    unsigned depth;
+    size_t chunk;                       /* the bytes of one request */
+
+    io_ring load_ring;                  /* block and walk loads */
+    std::mutex load_mtx;
+
+    io_ring spill_ring;                 /* walk spills of all threads */
+    std::mutex spill_mtx;
+    std::vector<request_t> spills;      /* one slot per spill ring entry, owns its staging buffer */
+    std::vector<unsigned> free_spills;
+    unsigned nqueued;                   /* spills prepared but not submitted yet */
+
+    void prepare(io_ring &ring, int opcode, request_t &req, uint64_t id) {
+        size_t len = min_value(req.len - req.done, chunk);
+        bool ok = ring.prepare(opcode, req.fd, req.buf + req.done, (unsigned)len, req.off + req.done, id);
+        assert(ok);
+        (void)ok;
+    }
+
+    /**
+     * check the completion `res` of `req`, true when it was interrupted and must be submitted again.
+     * An io error, a read past the end of the file or a write of no bytes is fatal.
+     */
+    bool resubmit(int res, const request_t &req, bool read) {
+        if(res == -EAGAIN || res == -EINTR) return true;
+        if(res < 0) {
+            logstream(LOG_FATAL) << (read ? "read" : "write") << " of " << req.len - req.done << " bytes at offset " << req.off + req.done
+                                 << " of fd " << req.fd << " failed : " << strerror(-res) << std::endl;
+        } else if(res == 0) {
+            logstream(LOG_FATAL) << (read ? "short file, fd " : "no bytes written, fd ") << req.fd << " at offset " << req.off + req.done << std::endl;
+        }
+        return false;
+    }
+
+    /** split [off, off + bytes) into chunks and keep `depth` of them in flight until all are read */
+    void read_range(int fd, void *buf, size_t bytes, off_t off) {
+        std::lock_guard<std::mutex> lock(load_mtx);
+        size_t nchunks = (bytes + chunk - 1) / chunk;
+        std::vector<request_t> chunks(nchunks);
+        for(size_t c = 0; c < nchunks; c++) {
+            chunks[c].fd   = fd;
+            chunks[c].buf  = (char*)buf + c * chunk;
+            chunks[c].off  = off + (off_t)(c * chunk);
+            chunks[c].len  = min_value(bytes - c * chunk, chunk);
+            chunks[c].done = 0;
+        }
+
+        size_t next = 0, inflight = 0;
+        while(next < nchunks || inflight > 0) {
+            while(next < nchunks && inflight < depth) {
+                prepare(load_ring, IORING_OP_READ, chunks[next], next);
+                next++, inflight++;
+            }
+            load_ring.submit(1);
+
+            uint64_t id;
+            int res;
+            while(load_ring.reap(id, res)) {
+                inflight--;
+                request_t &req = chunks[id];
+                bool again = resubmit(res, req, true);
+                if(!again) req.done += res;
+                if(again || req.done < req.len) {
+                    prepare(load_ring, IORING_OP_READ, req, id);
+                    inflight++;
+                }
+            }
+        }
+    }
+
+    /** retire the finished spills, must hold `spill_mtx` */
+    void reap_spills() {
+        uint64_t id;
+        int res;
+        while(spill_ring.reap(id, res)) {
+            request_t &req = spills[id];
+            bool again = resubmit(res, req, false);
+            if(!again) req.done += res;
+            if(again || req.done < req.len) {
+                prepare(spill_ring, IORING_OP_WRITE, req, id);
+                nqueued++;
+            } else {
+                req.busy = false;
+                free_spills.push_back((unsigned)id);
+            }
+        }
+    }
+
+public:
+    uring_driver(graph_config *conf) : graph_driver(conf) {
+        chunk = IO_CHUNK_SIZE;
+        depth = max_value(conf->io_depth, 1u);
+        ready = load_ring.setup(depth) && spill_ring.setup(depth);
+        if(ready) depth = min_value(load_ring.depth(), spill_ring.depth());
+
+        spills.resize(depth);
+        for(unsigned s = 0; s < depth; s++) {
+            spills[s].buf  = NULL;
+            spills[s].cap  = 0;
+            spills[s].busy = false;
+            free_spills.push_back(s);
+        }
+        nqueued = 0;
+    }
+
+    ~uring_driver() {
+        if(ready) sync_walks();
+        for(auto & req : spills) {
+            if(req.buf) free(req.buf);
+        }
+    }
+
+    /** false if the running kernel does not allow io_uring */
+    bool ok() const { return ready; }
+
+    void load_block(int vertdesc, int edgedesc, cache_block &cb, const block_t &block) {
+        if(cb.mapped) {
+            cb.beg_pos = NULL;
+            cb.csr     = NULL;
+            cb.mapped  = false;
+        }
+        cb.beg_pos = (eid_t*)realloc(cb.beg_pos, (block.nverts + 1) * sizeof(eid_t));
+        cb.csr     = (vid_t*)realloc(cb.csr, block.nedges * sizeof(vid_t));
+        read_range(vertdesc, cb.beg_pos, (block.nverts + 1) * sizeof(eid_t), block.start_vert * sizeof(eid_t));
+        read_range(edgedesc, cb.csr, block.nedges * sizeof(vid_t), block.start_edge * sizeof(vid_t));
+        load_block_weights(cb, block);
+    }
+
+    void load_block_weights(cache_block &cb, const block_t &block) {
+        if(accdesc >= 0) {
+            cb.acc = (real_t*)realloc(cb.acc, max_value(block.nedges, 1) * sizeof(real_t));
+            read_range(accdesc, cb.acc, block.nedges * sizeof(real_t), block.start_edge * sizeof(real_t));
+        }
+        if(probdesc < 0) return;
+        cb.prob  = (real_t*)realloc(cb.prob, max_value(block.nedges, 1) * sizeof(real_t));
+        cb.alias = (vid_t*)realloc(cb.alias, max_value(block.nedges, 1) * sizeof(vid_t));
+        read_range(probdesc, cb.prob, block.nedges * sizeof(real_t), block.start_edge * sizeof(real_t));
+        read_range(aliasdesc, cb.alias, block.nedges * sizeof(vid_t), block.start_edge * sizeof(vid_t));
+    }
+
+    /** the spills of the store may still be in flight, so drain them before reading it back */
+    void load_walk(int fd, void *buf, size_t bytes, off_t off) {
+        sync_walks();
+        read_range(fd, buf, bytes, off);
+    }
+
+    /**
+     * copy the walks into a staging buffer and queue a write at `off`, the caller can reuse its buffer
+     * at once. The queued writes of all threads are submitted together once a quarter of the ring is filled.
+     */
+    void dump_walk(int fd, const void *buf, size_t bytes, off_t off) {
+        std::lock_guard<std::mutex> lock(spill_mtx);
+        reap_spills();
+        while(free_spills.empty()) {
+            spill_ring.submit(1);
+            nqueued = 0;
+            reap_spills();
+        }
+
+        unsigned id = free_spills.back();
+        free_spills.pop_back();
+        request_t &req = spills[id];
+        if(req.cap < bytes) {
+            req.buf = (char*)realloc(req.buf, bytes);
+            req.cap = bytes;
+        }
+        memcpy(req.buf, buf, bytes);
+        req.fd   = fd;
+        req.off  = off;
+        req.len  = bytes;
+        req.done = 0;
+        req.busy = true;
+        prepare(spill_ring, IORING_OP_WRITE, req, id);
+
+        if(++nqueued >= max_value(depth / 4, 1u)) {
+            spill_ring.submit(0);
+            nqueued = 0;
+        }
+    }
+
+    /** submit the queued spills and wait for all of them */
+    void sync_walks() {
+        std::lock_guard<std::mutex> lock(spill_mtx);
+        reap_spills();
+        while(free_spills.size() < depth) {
+            spill_ring.submit(1);
+            nqueued = 0;
+            reap_spills();
+        }
+    }
+};
+#endif
+
+class compressed_driver : public graph_driver {
+private:
+    int degdesc, zcsrdesc;
+    std::vector<eid_t> offsets;         /* the byte offset of each block in `.zcsr` */
+
+    std::mutex stat_mtx;
+    double io_time, decode_time;
+    size_t io_bytes, raw_bytes;
+
+public:
+    compressed_driver(graph_config *conf) : graph_driver(conf) {
+        std::string degree_name = get_degree_name(conf->base_name, conf->fnum);
+        std::string zcsr_name   = get_compressed_csr_name(conf->base_name, conf->fnum);
+        offsets  = load_graph_blocks<eid_t>(get_compressed_index_name(conf->base_name, conf->blocksize));
+        degdesc  = open(degree_name.c_str(), O_RDONLY);
+        zcsrdesc = open(zcsr_name.c_str(), O_RDONLY);
+        assert(degdesc >= 0 && zcsrdesc >= 0);
+        io_time = decode_time = 0.0;
+        io_bytes = raw_bytes = 0;
+    }
+
+    ~compressed_driver() {
+        close(degdesc);
+        close(zcsrdesc);
+        logstream(LOG_INFO) << "compressed driver : read " << io_bytes << " bytes for " << raw_bytes << " raw bytes, io time : " << io_time << "s, decode time : " << decode_time << "s" << std::endl;
+    }
+
+    /** read the block degrees and encoded neighbors, then rebuild `beg_pos` and decode `csr` */
+    void load_block(int vertdesc, int edgedesc, cache_block &cb, const block_t &block) {
+        if(cb.mapped) {
+            cb.beg_pos = NULL;
+            cb.csr     = NULL;
+            cb.mapped  = false;
+        }
+        size_t bytes = offsets[block.blk + 1] - offsets[block.blk];
+        cb.beg_pos = (eid_t*)realloc(cb.beg_pos, (block.nverts + 1) * sizeof(eid_t));
+        cb.csr     = (vid_t*)realloc(cb.csr, block.nedges * sizeof(vid_t));
+        vid_t *degree = (vid_t*)malloc(max_value(block.nverts, 1) * sizeof(vid_t));
+        uint8_t *buf  = (uint8_t*)malloc(bytes + GV_PADDING);
+        assert(degree != NULL && buf != NULL);
+
+        graph_timer timer;
+        timer.start_time();
+        load_block_range(degdesc, degree, block.nverts, block.start_vert * sizeof(vid_t));
+        load_block_range(zcsrdesc, buf, bytes, offsets[block.blk]);
+        double io = timer.runtime();
+
+        timer.start_time();
+        cb.beg_pos[0] = block.start_edge;
+        for(vid_t v = 0; v < block.nverts; v++) cb.beg_pos[v + 1] = cb.beg_pos[v] + degree[v];
+        assert(cb.beg_pos[block.nverts] == block.start_edge + block.nedges);
+        gv_decode(buf, block.nedges, cb.csr);
+        delta_decode_block(cb.beg_pos, block.nverts, block.start_edge, cb.csr);
+        double decode = timer.runtime();
+
+        free(degree);
+        free(buf);
+        load_block_weights(cb, block);
+
+        std::lock_guard<std::mutex> lock(stat_mtx);
+        io_time += io;
+        decode_time += decode;
+        io_bytes += bytes + block.nverts * sizeof(vid_t);
+        raw_bytes += block.nedges * sizeof(vid_t) + (block.nverts + 1) * sizeof(eid_t);
+    }
+};
+
+/** create the graph driver by name, `pread`, `mmap`, `uring` or `compressed` */
+graph_driver *create_driver(const std::string& name, graph_config *conf) {
+    if(name == "mmap") return new mmap_driver(conf);
+    if(name == "compressed") return new compressed_driver(conf);
+    if(name == "uring") {
+#ifdef HAVE_IO_URING
+        uring_driver *driver = new uring_driver(conf);
+        if(driver->ok()) return driver;
+        delete driver;
+#endif
+        logstream(LOG_WARNING) << "io_uring is not available, use pread driver." << std::endl;
+        return new graph_driver(conf);
+    }
+    if(name != "pread") {
+        logstream(LOG_WARNING) << "unknown driver " << name << ", use pread driver." << std::endl;
+    }
+    return new graph_driver(conf);
+}
+
 #endif
\ No newline at end of file
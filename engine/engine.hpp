@@ -3,6 +3,7 @@
 
 #include "cache.hpp"
 #include "schedule.hpp"
+#include "steal.hpp"
 #include "apps/randomwalk.hpp"
 #include "util/timer.hpp"
 
@@ -14,19 +15,28 @@ public:
     graph_driver *driver;
     graph_config *conf;
     graph_timer      timer;
+    walk_stealer     *stealer;
+    std::vector<double> busy, idle;     /* the seconds each thread spent running walks and waiting in block execution */
+    size_t npasses, nhandoffs;          /* the multi-block passes, and the walks handed off between resident blocks */
 
     graph_engine(graph_cache& _cache, graph_walk& mangager, graph_driver& _driver, graph_config& _conf) {
         cache         = &_cache;
         walk_mangager = &mangager;
         driver        = &_driver;
         conf          = &_conf;
+        walk_mangager->global_cache = cache;
+        stealer = new walk_stealer(conf->nthreads);
+        busy.assign(conf->nthreads, 0.0);
+        idle.assign(conf->nthreads, 0.0);
+        npasses = nhandoffs = 0;
     }
 
+    ~graph_engine() { delete stealer; }
+
     void prologue(randomwalk_t& userprogram) {
         logstream(LOG_INFO) << "  =================  STARTED  ======================  " << std::endl;
         logstream(LOG_INFO) << "Random walks, random generate " << userprogram.get_numsources() << " walks on whole graph." << std::endl;
-        logstream(LOG_INFO) << "vertices : " << conf->nvertices << ", edges : " << conf->nedges << std::endl;
-        srand(time(0));
+        logstream(LOG_INFO) << "vertices : " << conf->nvertices << ", edges : " << conf->nedges << ", seed : " << conf->seed << std::endl;
         tid_t exec_threads = conf->nthreads;
         omp_set_num_threads(exec_threads);
 
@@ -34,10 +44,13 @@ public:
         {
             #pragma omp parallel for schedule(static)
             for(wid_t idx = 0; idx < userprogram.get_numsources(); idx++) {
-                vid_t s = rand() % walk_mangager->nvertices;
+                /* hop 0 is never used by a running walk, so the source draw has its own stream */
+                rand_t rng(conf->seed, idx, 0);
+                vid_t s = userprogram.source(idx, walk_mangager->nvertices, rng);
                 bid_t blk = walk_mangager->global_blocks->get_block(s);
-                walk_t walk = walk_encode(userprogram.get_hops(), s, s);
+                walk_t walk = walk_encode(userprogram.get_hops(), s, s, idx);
                 walk_mangager->move_walk(walk, blk, omp_get_thread_num(), s, userprogram.get_hops());
+                if(walk_mangager->paths) walk_mangager->paths->record(omp_get_thread_num(), idx, 0, s);
             }
         }
 
@@ -50,45 +63,164 @@ public:
         logstream(LOG_DEBUG) << "graph blocks : " << walk_mangager->global_blocks->nblocks << ", memory blocks : " << cache->ncblock << std::endl;
         logstream(LOG_INFO) << "Random walks start executing, please wait for a minute." << std::endl;
         timer.start_time();
+        graph_timer phase;
+        double sort_time = 0.0, exec_time = 0.0;
         int run_count = 0;
         while(!walk_mangager->test_finished_walks()) {
             run_count++;
             bid_t exec_idx = block_scheduler.schedule(*cache, *driver, *walk_mangager);
             exec_block = cache->cache_blocks[exec_idx].block->blk;
             cache_block *run_block  = &cache->cache_blocks[exec_idx];
+            if(conf->multi_block) {
+                phase.start_time();
+                exec_resident_blocks(userprogram, block_scheduler);
+                exec_time += phase.runtime();
+                continue;
+            }
             run_block->block->status = USING;
 
             /* load `exec_block` walks into memory */
             wid_t nwalks = walk_mangager->nblockwalks(exec_block);
             if(nwalks == 0) continue; // if no walks, no need to load walkers
             walk_mangager->load_walks(exec_block);
+            if(walk_mangager->pipeline) walk_mangager->pipeline->prefetch(block_scheduler.predict(*walk_mangager, exec_block));
+            if(conf->sort_walks) {
+                phase.start_time();
+                walk_mangager->sort_walks(exec_block);
+                sort_time += phase.runtime();
+            }
 
             if(run_count % 100 == 0) 
             {
                 logstream(LOG_DEBUG) << timer.runtime() << "s : run count : " << run_count << std::endl;
                 logstream(LOG_INFO) << "exec_block : " << exec_block << ", walk num : " << nwalks << std::endl;
             }
-            exec_block_walk(userprogram, nwalks, run_block);
+            phase.start_time();
+            exec_block_walk(userprogram, walk_mangager->walks.buffer_begin(), nwalks, run_block);
+            exec_time += phase.runtime();
+            userprogram.block_finished(walk_mangager);
             walk_mangager->dump_walks(exec_block);
             run_block->block->status = USED;
         }
+        if(conf->multi_block) logstream(LOG_INFO) << "multi-block passes : " << npasses << ", walks handed off in memory : " << nhandoffs << std::endl;
+        if(walk_mangager->pipeline) {
+            double total = timer.runtime();
+            walk_pipeline *pl = walk_mangager->pipeline;
+            logstream(LOG_INFO) << "stage utilization : compute " << 100.0 * exec_time / total << "%, walk load " << 100.0 * pl->load_busy / total
+                                << "% (engine waited " << pl->load_wait << "s), spill " << 100.0 * pl->spill_busy / total << "%" << std::endl;
+        }
+        logstream(LOG_INFO) << "block execution : " << exec_time << "s" << (conf->sort_walks ? ", walk sort : " + std::to_string(sort_time) + "s" : "") << std::endl;
         logstream(LOG_DEBUG) << timer.runtime() << "s, total run count : " << run_count << std::endl;
     }
 
     void epilogue(randomwalk_t& userprogram) { 
+        double total = 0.0, most = 0.0;
+        tid_t nactive = 0;      /* the threads which joined a team, a thread limit can keep the others out */
+        std::string threads;
+        for(tid_t t = 0; t < conf->nthreads; t++) {
+            if(busy[t] + idle[t] > 0.0) nactive++;
+            total += busy[t], most = max_value(most, busy[t]);
+            threads += " " + std::to_string(t) + ":" + std::to_string(busy[t]) + "/" + std::to_string(idle[t]);
+        }
+        logstream(LOG_INFO) << "thread busy/idle seconds :" << threads << std::endl;
+        logstream(LOG_INFO) << (conf->steal ? "work stealing" : "static split") << ", max/mean busy : " << most / (total / max_value(nactive, (tid_t)1))
+                            << (conf->steal ? ", steals : " + std::to_string(stealer->nsteals) : "") << std::endl;
         logstream(LOG_INFO) << "  ================= FINISHED ======================  " << std::endl;
     }
 
-    void exec_block_walk(randomwalk_t &userprogram, wid_t nwalks, cache_block *run_block) {
-        if(nwalks < 100) omp_set_num_threads(1);
-        else omp_set_num_threads(conf->nthreads);
+    /**
+     * run the walks of every ready cache slot together. Their walks are loaded into one list, and a walk
+     * which steps into another resident block is handed off in memory by `move_walk` and continues in
+     * the next pass, until no walk is left in the resident blocks. Only the walks leaving for a block
+     * which is not cached are buffered and spilled.
+     */
+    void exec_resident_blocks(randomwalk_t &userprogram, scheduler &block_scheduler) {
+        std::vector<bid_t> blocks;
+        wid_t total = 0;
+        for(bid_t p = 0; p < cache->ncblock; p++) {
+            cache_block &cb = cache->cache_blocks[p];
+            if(cb.block == NULL || cb.block->status == LOADING || cb.block->status == INACTIVE) continue;
+            cb.block->status = USING;
+            walk_mangager->resident[cb.block->blk] = &cb;
+            blocks.push_back(cb.block->blk);
+            total += walk_mangager->nblockwalks(cb.block->blk);
+        }
+
+        graph_walk &wm = *walk_mangager;
+        wm.walks.alloc(total);
+        for(bid_t blk : blocks) {
+            size_t first = wm.walks.size();
+            wm.append_walks(blk);
+            if(conf->sort_walks) wm.sort_walks(blk, first);
+            wm.release_walks(blk);
+        }
+        if(wm.pipeline) wm.pipeline->prefetch(block_scheduler.predict(wm, blocks.front()));
+
+        walk_t *list = wm.walks.buffer_begin();
+        size_t nwalks = wm.walks.size();
+        std::vector<walk_t> next;
+        while(nwalks > 0) {
+            exec_block_walk(userprogram, list, nwalks, NULL);
+            npasses++;
+            next.clear();
+            for(tid_t t = 0; t < conf->nthreads; t++) {
+                next.insert(next.end(), wm.handoff[t].begin(), wm.handoff[t].end());
+                wm.handoff[t].clear();
+            }
+            nhandoffs += next.size();
+            list = next.data(), nwalks = next.size();
+        }
+        userprogram.block_finished(walk_mangager);
+
+        /* the hops recorded for the handed off walks are stale, the resident blocks have no walk left */
+        for(bid_t blk : blocks) {
+            wm.resident[blk] = NULL;
+            wm.release_walks(blk);
+            wm.global_blocks->blocks[blk].status = USED;
+        }
+        wm.walks.destroy();
+    }
+
+    /**
+     * run the walks of the block, split statically or stolen in chunks with `walk_stealer`. The time
+     * each thread of the team spends in `update_walk` is its busy time, the rest of the block is its idle time.
+     * Without `run_block` each walk runs on the resident block of its position.
+     */
+    void exec_block_walk(randomwalk_t &userprogram, walk_t *walks, size_t nwalks, cache_block *run_block) {
+        tid_t nt = nwalks < 100 ? 1 : conf->nthreads;
+        omp_set_num_threads(nt);
+        std::vector<double> run(conf->nthreads, 0.0);
+        graph_timer block_timer;
+        block_timer.start_time();
 
+        #pragma omp parallel
         {
-            #pragma omp parallel for schedule(static)
-            for(wid_t idx = 0; idx < nwalks; idx++) {
-                userprogram.update_walk(walk_mangager->walks[idx], run_block, walk_mangager);
+            /* the team may be smaller than asked, e.g. under OMP_THREAD_LIMIT, the walks are split by its size */
+            #pragma omp single
+            {
+                nt = omp_get_num_threads();
+                if(conf->steal) stealer->reset(nwalks, nt);
+            }
+            tid_t t = omp_get_thread_num();
+            graph_timer chunk_timer;
+            size_t lo = (size_t)nwalks * t / nt, hi = (size_t)nwalks * (t + 1) / nt;
+            bool more = conf->steal ? stealer->next(t, lo, hi) : true;
+            while(more) {
+                chunk_timer.start_time();
+                for(size_t idx = lo; idx < hi; idx++) {
+                    cache_block *cb = run_block ? run_block : walk_mangager->resident[walk_mangager->global_blocks->get_block(walks[idx].pos)];
+                    userprogram.update_walk(walks[idx], cb, walk_mangager);
+                }
+                run[t] += chunk_timer.runtime();
+                more = conf->steal && stealer->next(t, lo, hi);
             }
         }
+
+        double elapsed = block_timer.runtime();
+        for(tid_t t = 0; t < nt; t++) {
+            busy[t] += run[t];
+            idle[t] += elapsed - run[t];
+        }
     }
 };
 
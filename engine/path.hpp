@@ -0,0 +1,147 @@
+#ifndef _GRAPH_PATH_H_
+#define _GRAPH_PATH_H_
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include "api/types.hpp"
+#include "api/constants.hpp"
+#include "api/graph_buffer.hpp"
+#include "logger/logger.hpp"
+#include "util/io.hpp"
+#include "util/util.hpp"
+#include "util/external_sort.hpp"
+
+/** path
+ *
+ * This file defines the path recording of the walks. Every step appends `(walk id, step, vertex)` to
+ * the buffer of the executing thread, a full buffer is written to the thread's own `.path` fragment
+ * file, so recording takes no lock. A walk's steps are spread over the fragments of the threads and
+ * blocks which executed it, `stitch` sorts them by (walk id, step) externally and writes one sequence
+ * per walk, in the original vertex ids when the graph was reordered.
+ */
+
+/** the `step`-th vertex of walk `id`, 10 bytes on disk */
+struct path_record_t {
+    wid_t id;
+    vid_t vertex;
+    hid_t step;
+} __attribute__((packed));
+
+struct path_less {
+    bool operator()(const path_record_t& a, const path_record_t& b) const {
+        return a.id < b.id || (a.id == b.id && a.step < b.step);
+    }
+};
+
+class path_recorder {
+public:
+    std::string base_name;
+    tid_t nthreads;
+    graph_buffer<path_record_t> *buffers;  /* the unwritten records of each thread */
+    std::vector<int> desc;                 /* the fragment file of each thread */
+    std::vector<off_t> written;            /* the bytes written to each fragment */
+
+    path_recorder(const std::string& base, tid_t threads) {
+        base_name = base;
+        nthreads  = threads;
+        buffers   = new graph_buffer<path_record_t>[nthreads];
+        desc.resize(nthreads);
+        written.assign(nthreads, 0);
+        for(tid_t t = 0; t < nthreads; t++) {
+            buffers[t].alloc(PATH_TRECORDS);
+            desc[t] = open(get_path_fragment_name(base_name, t).c_str(), O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+            assert(desc[t] >= 0);
+        }
+    }
+
+    ~path_recorder() {
+        for(tid_t t = 0; t < nthreads; t++) {
+            close(desc[t]);
+            test_delete(get_path_fragment_name(base_name, t));
+        }
+        delete [] buffers;
+    }
+
+    void record(tid_t tid, wid_t id, hid_t step, vid_t vertex) {
+        path_record_t rec;
+        rec.id = id, rec.step = step, rec.vertex = vertex;
+        if(!buffers[tid].push_back(rec)) {
+            flush(tid);
+            buffers[tid].push_back(rec);
+        }
+    }
+
+    void flush(tid_t tid) {
+        graph_buffer<path_record_t> &buf = buffers[tid];
+        dump_block_range(desc[tid], buf.buffer_begin(), buf.size(), written[tid]);
+        written[tid] += buf.size() * sizeof(path_record_t);
+        buf.clear();
+    }
+
+    /**
+     * sort the fragments into the walk sequences and write them to `output`: with `text` one line of
+     * space separated vertices per walk, otherwise `<id> <length> <vertices>` as 4 byte integers.
+     */
+    void stitch(const std::string& output, bool text, size_t memory) {
+        size_t nrecords = 0;
+        for(tid_t t = 0; t < nthreads; t++) {
+            flush(t);
+            nrecords += written[t] / sizeof(path_record_t);
+        }
+        std::vector<vid_t> perm;
+        if(test_exists(get_perm_name(base_name))) perm = load_graph_blocks<vid_t>(get_perm_name(base_name));
+        logstream(LOG_INFO) << "stitch " << nrecords << " path records into " << output << (perm.empty() ? "" : ", original vertex ids") << std::endl;
+
+        external_sorter<path_record_t, path_less> sorter(base_name + "_path", min_value(memory, (nrecords + 1) * sizeof(path_record_t)));
+        std::vector<path_record_t> chunk(PATH_TRECORDS);
+        for(tid_t t = 0; t < nthreads; t++) {
+            size_t count = written[t] / sizeof(path_record_t);
+            for(size_t off = 0; off < count; off += chunk.size()) {
+                size_t n = min_value(chunk.size(), count - off);
+                load_block_range(desc[t], chunk.data(), n, off * sizeof(path_record_t));
+                for(size_t i = 0; i < n; i++) sorter.add(chunk[i]);
+            }
+        }
+
+        auto out = std::fstream(output.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+        std::vector<vid_t> seq;
+        wid_t curr = 0, nseqs = 0, gaps = 0;
+        auto emit = [&]() {
+            if(seq.empty()) return;
+            if(text) {
+                std::string line;
+                for(size_t i = 0; i < seq.size(); i++) {
+                    if(i) line += ' ';
+                    line += std::to_string(seq[i]);
+                }
+                line += '\n';
+                out.write(line.data(), line.size());
+            } else {
+                uint32_t len = seq.size();
+                out.write((char*)&curr, sizeof(wid_t));
+                out.write((char*)&len, sizeof(uint32_t));
+                out.write((char*)seq.data(), seq.size() * sizeof(vid_t));
+            }
+            nseqs++;
+            seq.clear();
+        };
+        sorter.merge([&](const path_record_t& rec) {
+            if(rec.id != curr || seq.empty()) {
+                emit();
+                curr = rec.id;
+            }
+            /* a step is missing when the sequence does not count up from 0 */
+            if(rec.step != seq.size()) gaps++;
+            seq.push_back(perm.empty() ? rec.vertex : perm[rec.vertex]);
+        });
+        emit();
+        out.close();
+        if(gaps) logstream(LOG_WARNING) << gaps << " steps are out of sequence in the recorded paths" << std::endl;
+        logstream(LOG_INFO) << "wrote " << nseqs << " walk sequences to " << output << std::endl;
+    }
+};
+
+#endif
@@ -0,0 +1,188 @@
+#ifndef _GRAPH_PIPELINE_H_
+#define _GRAPH_PIPELINE_H_
+
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include "api/types.hpp"
+#include "api/constants.hpp"
+#include "logger/logger.hpp"
+#include "util/timer.hpp"
+#include "util/codec.hpp"
+#include "spill.hpp"
+
+/** pipeline
+ *
+ * This file defines the background stages which move the walks between memory and the spill store
+ * while the blocks compute. The spill stage owns all writes to the store: a full walk buffer is copied
+ * into a job of a queue of at most `PIPELINE_SPILL_JOBS` batches, and the computing thread only waits
+ * when the queue is full. The load stage reads ahead the spilled walks of the block predicted to run
+ * next. It takes the bytes the spill stage has written for that block so far, and when the block is
+ * scheduled only the walks spilled to it since then are read in the foreground.
+ *
+ * Each stage counts its busy seconds, so the engine can show which stage bounds the run.
+ */
+class walk_pipeline {
+public:
+    struct spill_job {
+        bid_t blk;
+        std::vector<uint8_t> bytes;
+    };
+
+    walk_store *store;
+    bid_t nblocks;
+    std::deque<spill_job> jobs;         /* the spill queue */
+    std::vector<wid_t> pending;         /* the queued spill jobs of each block */
+    std::vector<size_t> spilled;        /* the bytes of each block written by the spill stage */
+
+    bid_t request;                      /* the block to read ahead, `nblocks` for none */
+    bid_t loading;                      /* the block being read ahead, `nblocks` for none */
+    bid_t staged_blk;                   /* the block of `staged`, `nblocks` for none */
+    std::vector<uint8_t> staged;        /* the read ahead bytes of `staged_blk` */
+    size_t staged_bytes;
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::thread spill_thread, load_thread;
+    bool stop;
+
+    double spill_busy, load_busy;       /* the seconds the stages spent on io */
+    double spill_stall, load_wait;      /* the seconds compute waited on a full spill queue, the engine on walk loads */
+    size_t nspills, nhits, nmisses;     /* spill jobs, loads found read ahead or read in the foreground */
+
+    walk_pipeline(walk_store *s, bid_t blocks) {
+        store = s;
+        nblocks = blocks;
+        pending.assign(nblocks, 0);
+        spilled.assign(nblocks, 0);
+        request = loading = staged_blk = nblocks;
+        staged_bytes = 0;
+        stop = false;
+        spill_busy = load_busy = spill_stall = load_wait = 0.0;
+        nspills = nhits = nmisses = 0;
+        spill_thread = std::thread(&walk_pipeline::spill_stage, this);
+        load_thread  = std::thread(&walk_pipeline::load_stage, this);
+    }
+
+    ~walk_pipeline() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stop = true;
+        }
+        cv.notify_all();
+        spill_thread.join();
+        load_thread.join();
+        logstream(LOG_INFO) << "pipeline : " << nspills << " spill jobs, walk loads read ahead : " << nhits << ", in foreground : " << nmisses
+                            << ", compute stalled on spills : " << spill_stall << "s" << std::endl;
+    }
+
+    /** queue `len` bytes of walks of block `blk` for the spill stage, wait while the queue is full */
+    void spill(bid_t blk, const void *buf, size_t len) {
+        spill_job job;
+        job.blk = blk;
+        job.bytes.assign((const uint8_t*)buf, (const uint8_t*)buf + len);
+        std::unique_lock<std::mutex> lock(mtx);
+        if(jobs.size() >= PIPELINE_SPILL_JOBS) {
+            graph_timer timer;
+            timer.start_time();
+            cv.wait(lock, [this] { return jobs.size() < PIPELINE_SPILL_JOBS; });
+            spill_stall += timer.runtime();
+        }
+        jobs.push_back(std::move(job));
+        pending[blk]++;
+        cv.notify_all();
+    }
+
+    /** ask the load stage to read ahead the walks of `blk`, ignored while it is busy */
+    void prefetch(bid_t blk) {
+        std::lock_guard<std::mutex> lock(mtx);
+        if(blk >= nblocks || loading != nblocks || staged_blk == blk) return;
+        request = blk;
+        cv.notify_all();
+    }
+
+    /**
+     * the spilled bytes of `blk` in `out`, with `GV_PADDING` bytes of slack, once its queued spills are
+     * written. The read ahead part is taken over and the rest is read here, the count of the block is reset.
+     */
+    size_t take(bid_t blk, std::vector<uint8_t> &out) {
+        graph_timer timer;
+        timer.start_time();
+        size_t have = 0, total;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            if(request == blk) request = nblocks;
+            cv.wait(lock, [this, blk] { return loading != blk && pending[blk] == 0; });
+            total = spilled[blk];
+            spilled[blk] = 0;
+            if(staged_blk == blk) {
+                out.swap(staged);
+                have = staged_bytes;
+                staged_blk = nblocks;
+                nhits++;
+            } else if(total > 0) {
+                nmisses++;
+            }
+        }
+        out.resize(total + GV_PADDING);
+        if(total > have) store->load(blk, out.data() + have, have, total);
+        load_wait += timer.runtime();
+        return total;
+    }
+
+private:
+    void spill_stage() {
+        std::unique_lock<std::mutex> lock(mtx);
+        while(true) {
+            cv.wait(lock, [this] { return stop || !jobs.empty(); });
+            if(jobs.empty()) break;
+            spill_job job = std::move(jobs.front());
+            jobs.pop_front();
+            cv.notify_all();
+            lock.unlock();
+
+            graph_timer timer;
+            timer.start_time();
+            store->append(job.blk, job.bytes.data(), job.bytes.size());
+            double busy = timer.runtime();
+
+            lock.lock();
+            spill_busy += busy;
+            spilled[job.blk] += job.bytes.size();
+            pending[job.blk]--;
+            nspills++;
+            cv.notify_all();
+        }
+    }
+
+    void load_stage() {
+        std::unique_lock<std::mutex> lock(mtx);
+        std::vector<uint8_t> buf;
+        while(true) {
+            cv.wait(lock, [this] { return stop || request != nblocks; });
+            if(stop) break;
+            bid_t blk = request;
+            size_t bytes = spilled[blk];
+            request = nblocks;
+            loading = blk;
+            lock.unlock();
+
+            graph_timer timer;
+            timer.start_time();
+            buf.resize(bytes + GV_PADDING);
+            if(bytes > 0) store->load(blk, buf.data(), 0, bytes);
+            double busy = timer.runtime();
+
+            lock.lock();
+            load_busy += busy;
+            staged.swap(buf);
+            staged_blk = blk, staged_bytes = bytes;
+            loading = nblocks;
+            cv.notify_all();
+        }
+    }
+};
+
+#endif
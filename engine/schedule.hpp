@@ -5,6 +5,8 @@
 #include <algorithm>
 #include <utility>
 #include <queue>
+#include <future>
+#include <chrono>
 
 #include "cache.hpp"
 #include "config.hpp"
@@ -45,6 +47,9 @@ public:
     }
     virtual bid_t schedule(graph_cache& cache, graph_driver& driver, graph_walk &walk_manager) = 0;
 
+    /** the block expected to be scheduled after `exec`, `nblocks` when there is no guess */
+    virtual bid_t predict(graph_walk &walk_manager, bid_t exec) { return walk_manager.global_blocks->nblocks; }
+
 };
 
 class graph_scheduler : public scheduler {
@@ -73,6 +78,7 @@ public:
         for(bid_t p = 0; p < cache.ncblock; p++) {
             if(cache.cache_blocks[p].block != NULL) {
                 cache.cache_blocks[p].block->status = INACTIVE;
+                driver.unload_block(cache.cache_blocks[p]);
             }
         }
 
@@ -84,11 +90,7 @@ public:
         for(const auto & p : blocks) {
             cache.cache_blocks[blk].block  = &global_blocks->blocks[p];
             cache.cache_blocks[blk].block->status = ACTIVE;
-            cache.cache_blocks[blk].beg_pos = (eid_t*)realloc(cache.cache_blocks[blk].beg_pos, (global_blocks->blocks[p].nverts + 1) * sizeof(eid_t));
-            cache.cache_blocks[blk].csr     = (vid_t*)realloc(cache.cache_blocks[blk].csr   , global_blocks->blocks[p].nedges * sizeof(vid_t));
-
-            driver.load_block_vertex(vertdesc, cache.cache_blocks[blk].beg_pos, global_blocks->blocks[p]);
-            driver.load_block_edge(edgedesc,  cache.cache_blocks[blk].csr,    global_blocks->blocks[p]);
+            driver.load_block(vertdesc, edgedesc, cache.cache_blocks[blk], global_blocks->blocks[p]);
             blk++;
         }
 
@@ -103,7 +105,7 @@ public:
         std::vector<bid_t> blocks;
         std::priority_queue<std::pair<bid_t, rank_t>, std::vector<std::pair<bid_t, rank_t>>, rank_compare> pq;
         for(bid_t blk = 0; blk < global_blocks->nblocks; blk++) {
-            pq.push(std::make_pair(blk, global_blocks->blocks[blk].rank));
+            pq.push(std::make_pair(blk, global_blocks->rank(blk)));
         }
 
         while(!pq.empty() && ncblocks) {
@@ -122,50 +124,190 @@ public:
 
 /**
  * The following schedule scheme follow the graph walker scheme
+ *
+ * While the chosen block executes, a background I/O stage loads the `depth` blocks the same
+ * max-hops/max-walks policy is expected to pick next into spare cache slots, so disk reads
+ * overlap with walk computation. The slots being filled are marked `LOADING`, and a schedule
+ * which picks one of them waits only for that load.
  */
 class walk_schedule_t : public scheduler {
 private:
     float prob;
     bid_t exec_blk;
+    bid_t depth;                        /* number of blocks prefetched ahead */
+
+    struct prefetch_t {
+        bid_t slot;                     /* the cache slot being filled */
+        std::future<void> done;
+    };
+    std::vector<prefetch_t> inflight;
+    std::vector<bool> prefetched;       /* the slot holds a prefetched block not scheduled yet */
+    size_t nhits, nmisses;              /* scheduled blocks found prefetched or loaded on demand */
+
 public:
-    walk_schedule_t(graph_config* conf, float p) : scheduler(conf) {
-        // nothing need to initialize
+    walk_schedule_t(graph_config* conf, float p, bid_t prefetch_depth = 1) : scheduler(conf) {
         prob = p;
         exec_blk = 0;
+        depth = prefetch_depth;
+        nhits = nmisses = 0;
+    }
+
+    ~walk_schedule_t() {
+        /* `get` rethrows the failure of a background load */
+        for(auto & f : inflight) f.done.get();
+        logstream(LOG_DEBUG) << "prefetch hits : " << nhits << ", demand loads : " << nmisses << std::endl;
     }
 
     bid_t schedule(graph_cache& cache, graph_driver& driver, graph_walk &walk_manager) {
         bid_t blk = walk_manager.choose_block(prob);
+        graph_block *global_blocks = walk_manager.global_blocks;
+        if(prefetched.size() != cache.ncblock) prefetched.assign(cache.ncblock, false);
         if(cache.test_block_cached(blk, exec_blk)) {
-            return exec_blk;
+            wait_prefetch(cache, exec_blk);
+            if(prefetched[exec_blk]) nhits++;
+        } else {
+            nmisses++;
+            exec_blk = swap_block(cache, driver, walk_manager);
+            cache.cache_blocks[exec_blk].block = &global_blocks->blocks[blk];
+            cache.cache_blocks[exec_blk].block->status = ACTIVE;
+            driver.load_block(vertdesc, edgedesc, cache.cache_blocks[exec_blk], global_blocks->blocks[blk]);
         }
-        graph_block *global_blocks = walk_manager.global_blocks;
-        exec_blk = swap_block(cache, walk_manager);
-        cache.cache_blocks[exec_blk].block = &global_blocks->blocks[blk];
-        cache.cache_blocks[exec_blk].block->status = ACTIVE;
+        prefetched[exec_blk] = false;
 
-        cache.cache_blocks[exec_blk].beg_pos = (eid_t*)realloc(cache.cache_blocks[exec_blk].beg_pos, (global_blocks->blocks[blk].nverts + 1) * sizeof(eid_t));
-        cache.cache_blocks[exec_blk].csr     = (vid_t*)realloc(cache.cache_blocks[exec_blk].csr   , global_blocks->blocks[blk].nedges * sizeof(vid_t));
-
-        driver.load_block_vertex(vertdesc, cache.cache_blocks[exec_blk].beg_pos, global_blocks->blocks[blk]);
-        driver.load_block_edge(edgedesc,  cache.cache_blocks[exec_blk].csr,    global_blocks->blocks[blk]);
+        prefetch(cache, driver, walk_manager, blk);
         return exec_blk;
     }
 
-    bid_t swap_block(graph_cache& cache, graph_walk &walk_mangager) {
+    bid_t swap_block(graph_cache& cache, graph_driver& driver, graph_walk &walk_mangager) {
         wid_t walks_cnt = 0xffffffff;
-        bid_t blk = 0;
+        bid_t blk = cache.ncblock;
         for(bid_t p = 0; p < cache.ncblock; p++) {
             if(cache.cache_blocks[p].block == NULL) return p;
+            if(cache.cache_blocks[p].block->status == LOADING) continue;
             wid_t cnt = walk_mangager.nblockwalks(cache.cache_blocks[p].block->blk);
             if(walks_cnt > cnt) {
                 walks_cnt = cnt;
                 blk = p;
             }
         }
+        assert(blk < cache.ncblock);
         cache.cache_blocks[blk].block->status = INACTIVE;
+        driver.unload_block(cache.cache_blocks[blk]);
         return blk;
     }
+
+    bid_t predict(graph_walk &walk_manager, bid_t exec) {
+        std::vector<bid_t> blocks = predict_blocks(walk_manager, exec, 1);
+        return blocks.empty() ? walk_manager.global_blocks->nblocks : blocks[0];
+    }
+
+private:
+    /** wait the background load of `slot` if there is one, a failed load is raised here */
+    void wait_prefetch(graph_cache& cache, bid_t slot) {
+        for(size_t i = 0; i < inflight.size(); i++) {
+            if(inflight[i].slot != slot) continue;
+            inflight[i].done.get();
+            inflight.erase(inflight.begin() + i);
+            cache.cache_blocks[slot].block->status = ACTIVE;
+            return;
+        }
+    }
+
+    /** retire the finished background loads, keep the running ones */
+    void retire_prefetch(graph_cache& cache) {
+        for(size_t i = 0; i < inflight.size(); ) {
+            if(inflight[i].done.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+                inflight[i].done.get();
+                cache.cache_blocks[inflight[i].slot].block->status = ACTIVE;
+                inflight.erase(inflight.begin() + i);
+            } else {
+                i++;
+            }
+        }
+    }
+
+    /**
+     * predict the blocks chosen after `exec`: once `exec` runs its walks are gone, so the next choice
+     * is the max-hops or the max-walks block among the others, in the order of their probability.
+     */
+    std::vector<bid_t> predict_blocks(graph_walk &walk_manager, bid_t exec, bid_t count) {
+        bid_t nblocks = walk_manager.global_blocks->nblocks;
+        std::vector<bool> picked(nblocks, false);
+        std::vector<bid_t> blocks;
+        picked[exec] = true;
+        bool hops_first = prob >= 0.5;
+        while(blocks.size() < count) {
+            bid_t by_hops = nblocks, by_walks = nblocks;
+            hid_t max_hop = 0;
+            wid_t max_walks = 0;
+            for(bid_t p = 0; p < nblocks; p++) {
+                if(picked[p]) continue;
+                wid_t cnt = walk_manager.nblockwalks(p);
+                if(cnt == 0) continue;
+                hid_t hop = walk_manager.maxhops.reduce_max(p);
+                if(hop > max_hop) max_hop = hop, by_hops = p;
+                if(cnt > max_walks) max_walks = cnt, by_walks = p;
+            }
+            if(by_walks == nblocks) break;
+            if(by_hops == nblocks) by_hops = by_walks;
+            bid_t first = hops_first ? by_hops : by_walks, second = hops_first ? by_walks : by_hops;
+            blocks.push_back(first);
+            picked[first] = true;
+            if(blocks.size() < count && !picked[second]) {
+                blocks.push_back(second);
+                picked[second] = true;
+            }
+        }
+        return blocks;
+    }
+
+    /** choose a slot for a prefetched block: an empty slot, or the idle slot with the fewest walks */
+    bid_t prefetch_slot(graph_cache& cache, graph_walk &walk_manager, wid_t walks) {
+        bid_t slot = cache.ncblock;
+        wid_t walks_cnt = walks;
+        for(bid_t p = 0; p < cache.ncblock; p++) {
+            if(p == exec_blk) continue;
+            if(cache.cache_blocks[p].block == NULL) return p;
+            if(cache.cache_blocks[p].block->status == LOADING) continue;
+            wid_t cnt = walk_manager.nblockwalks(cache.cache_blocks[p].block->blk);
+            if(cnt < walks_cnt) {
+                walks_cnt = cnt;
+                slot = p;
+            }
+        }
+        return slot;
+    }
+
+    void prefetch(graph_cache& cache, graph_driver& driver, graph_walk &walk_manager, bid_t exec) {
+        if(depth == 0 || cache.ncblock < 2) return;
+        retire_prefetch(cache);
+
+        graph_block *global_blocks = walk_manager.global_blocks;
+        std::vector<bid_t> blocks = predict_blocks(walk_manager, exec, depth);
+        for(const auto & blk : blocks) {
+            if(inflight.size() >= depth) break;
+            bid_t slot;
+            if(cache.test_block_cached(blk, slot)) continue;
+            slot = prefetch_slot(cache, walk_manager, walk_manager.nblockwalks(blk));
+            if(slot == cache.ncblock) break;
+
+            cache_block *cb = &cache.cache_blocks[slot];
+            if(cb->block) {
+                cb->block->status = INACTIVE;
+                driver.unload_block(*cb);
+            }
+            cb->block = &global_blocks->blocks[blk];
+            cb->block->status = LOADING;
+            prefetched[slot] = true;
+
+            prefetch_t pf;
+            pf.slot = slot;
+            pf.done = std::async(std::launch::async, [this, &driver, cb]() {
+                driver.load_block(vertdesc, edgedesc, *cb, *cb->block);
+            });
+            inflight.push_back(std::move(pf));
+        }
+    }
 };
 
 #endif
@@ -0,0 +1,226 @@
+#ifndef _GRAPH_SPILL_H_
+#define _GRAPH_SPILL_H_
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <cstring>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include "api/types.hpp"
+#include "api/constants.hpp"
+#include "logger/logger.hpp"
+#include "util/util.hpp"
+#include "util/codec.hpp"
+#include "api/thread_counter.hpp"
+#include "driver.hpp"
+
+/** spill
+ *
+ * This file defines the store of the walks spilled to disk. All blocks share one `.spill` file of
+ * fixed size segments, preallocated `SPILL_GROW` segments at a time. Each block owns a chain of
+ * segments in write order and a spill appends to the tail of its chain, so the file descriptor count
+ * does not depend on the number of blocks. When the walks of a block are loaded the chain returns to
+ * the free list, the segments are recycled in the same order, so a chain tends to get adjacent
+ * segments and is read back in few large requests.
+ */
+class walk_store {
+public:
+    std::string name;
+    int fd;
+    graph_driver *driver;
+    size_t segment;                                 /* the bytes of one segment */
+    uint32_t nsegments;                             /* the segments allocated in the file */
+    std::vector<std::vector<uint32_t> > chains;     /* the segments of each block in write order */
+    std::vector<size_t> bytes;                      /* the bytes spilled for each block */
+    std::vector<uint32_t> free_segments;            /* a stack, the next segment to use is at the back */
+    std::mutex mtx;
+
+    walk_store(const std::string& base_name, bid_t nblocks, graph_driver *drv, size_t seg = SPILL_SEGMENT) {
+        name = get_spill_name(base_name);
+        fd = open(name.c_str(), O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+        assert(fd >= 0);
+        driver = drv;
+        segment = seg;
+        nsegments = 0;
+        chains.resize(nblocks);
+        bytes.assign(nblocks, 0);
+        grow();
+    }
+
+    ~walk_store() {
+        logstream(LOG_INFO) << "walk store : " << nsegments << " segments of " << segment / 1024 << "KB, " << free_segments.size() << " free at exit" << std::endl;
+        close(fd);
+        unlink(name.c_str());
+    }
+
+    /** extend the file by `SPILL_GROW` segments, must hold `mtx` */
+    void grow() {
+        uint32_t ngrow = SPILL_GROW;
+        int ret = posix_fallocate(fd, (off_t)nsegments * segment, (off_t)ngrow * segment);
+        if(ret != 0) logstream(LOG_WARNING) << "walk store : cannot preallocate " << ngrow << " segments, error " << ret << std::endl;
+        for(uint32_t s = nsegments + ngrow; s > nsegments; s--) free_segments.push_back(s - 1);
+        nsegments += ngrow;
+    }
+
+    /** append `len` bytes to the chain of block `blk`, the space is reserved under the lock and written outside */
+    void append(bid_t blk, const void *buf, size_t len) {
+        std::vector<std::pair<off_t, size_t> > extents;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            size_t left = len;
+            while(left > 0) {
+                size_t used = bytes[blk] % segment;
+                if(used == 0) {
+                    if(free_segments.empty()) grow();
+                    chains[blk].push_back(free_segments.back());
+                    free_segments.pop_back();
+                }
+                size_t n = min_value(segment - used, left);
+                extents.push_back(std::make_pair((off_t)chains[blk].back() * segment + (off_t)used, n));
+                bytes[blk] += n;
+                left -= n;
+            }
+        }
+        const char *p = (const char*)buf;
+        for(auto & ext : extents) {
+            driver->dump_walk(fd, p, ext.second, ext.first);
+            p += ext.second;
+        }
+    }
+
+    size_t size(bid_t blk) const { return bytes[blk]; }
+
+    /**
+     * read the bytes [from, to) of block `blk` into `buf`, the whole chain by default. The runs of adjacent
+     * segments are read at once, the extents are taken under the lock so the chain may grow meanwhile.
+     */
+    void load(bid_t blk, void *buf, size_t from = 0, size_t to = (size_t)-1) {
+        std::vector<std::pair<off_t, size_t> > extents;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            const std::vector<uint32_t> &chain = chains[blk];
+            to = min_value(to, bytes[blk]);
+            for(size_t i = from / segment; i < chain.size() && from < to; ) {
+                size_t j = i + 1;
+                while(j < chain.size() && chain[j] == chain[j - 1] + 1) j++;
+                size_t skip = from - i * segment, n = min_value((j - i) * segment - skip, to - from);
+                extents.push_back(std::make_pair((off_t)chain[i] * segment + (off_t)skip, n));
+                from += n;
+                i = j;
+            }
+        }
+        char *p = (char*)buf;
+        for(auto & ext : extents) {
+            driver->load_walk(fd, p, ext.second, ext.first);
+            p += ext.second;
+        }
+    }
+
+    /** return the chain of block `blk` to the free list, its first segment is reused first */
+    void release(bid_t blk) {
+        std::lock_guard<std::mutex> lock(mtx);
+        std::vector<uint32_t> &chain = chains[blk];
+        for(auto it = chain.rbegin(); it != chain.rend(); it++) free_segments.push_back(*it);
+        chain.clear();
+        bytes[blk] = 0;
+    }
+};
+
+
+/** the header of an encoded walk batch, the streams follow in this order */
+struct walk_batch_t {
+    uint32_t count;
+    uint32_t pos_bytes;     /* group varint of the `pos` gaps, the first one from the block's first vertex */
+    uint32_t prev_bytes;    /* group varint of the zigzag coded `prev - pos` */
+    uint8_t  hop_bits, source_bits, id_bits, pad;
+};
+
+/**
+ * The codec of the spilled walk batches. A batch is sorted by `pos` and the positions are stored as
+ * gaps from the block's first vertex, so they mostly take one byte. `prev` is usually a neighbor of
+ * `pos` and is stored as their difference, the hops, sources and ids are bit packed to the width of
+ * their largest value. The walk order within a block does not change the walks, they draw from the
+ * random stream of their id.
+ */
+class walk_codec {
+public:
+    std::vector<uint32_t> pos, prev, hop, source, id;
+    std::vector<uint8_t> data;      /* the encoded batch, or the loaded batches of a block */
+
+    /** sort the `n` walks of a batch by `pos` and encode them into `data`, return the bytes */
+    size_t encode(walk_t *walks, size_t n, vid_t base) {
+        std::sort(walks, walks + n, [](const walk_t& a, const walk_t& b) { return a.pos < b.pos; });
+        pos.resize(n), prev.resize(n), hop.resize(n), source.resize(n), id.resize(n);
+        uint32_t last = base & 0xffffff, hops = 0, sources = 0, ids = 0;
+        for(size_t i = 0; i < n; i++) {
+            pos[i] = (walks[i].pos - last) & 0xffffff;
+            last = walks[i].pos;
+            int32_t d = (int32_t)(walks[i].prev - (vid_t)walks[i].pos);
+            prev[i] = ((uint32_t)d << 1) ^ (uint32_t)(d >> 31);
+            hop[i] = walks[i].hop, source[i] = walks[i].source, id[i] = walks[i].id;
+            hops |= hop[i], sources |= source[i], ids |= id[i];
+        }
+
+        walk_batch_t head;
+        head.count = n;
+        head.hop_bits = bit_width(hops), head.source_bits = bit_width(sources), head.id_bits = bit_width(ids), head.pad = 0;
+        data.resize(sizeof(walk_batch_t) + 2 * gv_max_bytes(n) + bp_bytes(n, 16) + bp_bytes(n, 24) + bp_bytes(n, 32));
+        uint8_t *p = data.data() + sizeof(walk_batch_t);
+        head.pos_bytes = gv_encode(pos.data(), n, p);
+        p += head.pos_bytes;
+        head.prev_bytes = gv_encode(prev.data(), n, p);
+        p += head.prev_bytes;
+        p += bp_encode(hop.data(), n, head.hop_bits, p);
+        p += bp_encode(source.data(), n, head.source_bits, p);
+        p += bp_encode(id.data(), n, head.id_bits, p);
+        memcpy(data.data(), &head, sizeof(walk_batch_t));
+        return p - data.data();
+    }
+
+    /** decode the batches in the `bytes` bytes of `in` into `out`, return the number of walks, `in` needs `GV_PADDING` bytes of slack */
+    size_t decode(const uint8_t *in, size_t bytes, vid_t base, walk_t *out) {
+        const uint8_t *p = in, *end = in + bytes;
+        size_t nwalks = 0;
+        while(p < end) {
+            walk_batch_t head;
+            memcpy(&head, p, sizeof(walk_batch_t));
+            p += sizeof(walk_batch_t);
+            size_t n = head.count;
+            pos.resize(n), prev.resize(n), hop.resize(n), source.resize(n), id.resize(n);
+            gv_decode(p, n, pos.data());
+            p += head.pos_bytes;
+            gv_decode(p, n, prev.data());
+            p += head.prev_bytes;
+            bp_decode(p, n, head.hop_bits, hop.data());
+            p += bp_bytes(n, head.hop_bits);
+            bp_decode(p, n, head.source_bits, source.data());
+            p += bp_bytes(n, head.source_bits);
+            bp_decode(p, n, head.id_bits, id.data());
+            p += bp_bytes(n, head.id_bits);
+
+            uint32_t last = base & 0xffffff;
+            for(size_t i = 0; i < n; i++) {
+                walk_t &walk = out[nwalks + i];
+                last = (last + pos[i]) & 0xffffff;
+                walk.pos = last;
+                walk.prev = (vid_t)last + (vid_t)((prev[i] >> 1) ^ (0u - (prev[i] & 1)));
+                walk.hop = hop[i], walk.source = source[i], walk.id = id[i];
+            }
+            nwalks += n;
+        }
+        assert(p == end);
+        return nwalks;
+    }
+};
+
+/** the walks one thread spilled, their bytes on disk and the seconds spent encoding and writing them */
+struct spill_stat {
+    size_t bytes;
+    double seconds;
+    wid_t walks;
+    char pad[CACHE_LINE_SIZE - sizeof(size_t) - sizeof(double) - sizeof(wid_t)];
+};
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef _GRAPH_STEAL_H_
+#define _GRAPH_STEAL_H_
+
+#include <mutex>
+#include <vector>
+#include "api/types.hpp"
+#include "api/constants.hpp"
+#include "api/thread_counter.hpp"
+#include "util/util.hpp"
+
+/** steal
+ *
+ * This file defines the work stealing of a block's walks. Every thread owns a deque, the range of walk
+ * indices it has not started, which begins as its static share. The owner takes chunks from the front,
+ * `1 / STEAL_CHUNK_SHARE` of what is left but at least `STEAL_MIN_CHUNK`, so the chunks shrink as the
+ * range drains. A thread whose range is empty steals the back half of the first non empty range after
+ * its own. Walks are never added during a block, so a scan which finds all ranges empty ends the thread.
+ */
+
+struct walk_range {
+    std::mutex mtx;
+    size_t begin, end;
+    char pad[CACHE_LINE_SIZE];      /* keeps the ranges of two threads off one line */
+};
+
+class walk_stealer {
+public:
+    tid_t nthreads;
+    walk_range *ranges;
+    size_t nsteals;         /* the ranges stolen, a statistic */
+
+    walk_stealer(tid_t threads) {
+        nthreads = threads;
+        ranges = new walk_range[nthreads];
+        nsteals = 0;
+    }
+
+    ~walk_stealer() { delete [] ranges; }
+
+    /** split `n` walks among `nt` threads, the others start empty */
+    void reset(size_t n, tid_t nt) {
+        for(tid_t t = 0; t < nthreads; t++) {
+            ranges[t].begin = t < nt ? n * t / nt : n;
+            ranges[t].end   = t < nt ? n * (t + 1) / nt : n;
+        }
+    }
+
+    static size_t chunk_size(size_t left) {
+        return min_value(left, max_value(left / STEAL_CHUNK_SHARE, (size_t)STEAL_MIN_CHUNK));
+    }
+
+    /** give thread `t` its next chunk [lo, hi), return false when no walk is left */
+    bool next(tid_t t, size_t &lo, size_t &hi) {
+        {
+            walk_range &r = ranges[t];
+            std::lock_guard<std::mutex> lock(r.mtx);
+            if(r.begin < r.end) {
+                lo = r.begin, hi = r.begin + chunk_size(r.end - r.begin);
+                r.begin = hi;
+                return true;
+            }
+        }
+        for(tid_t i = 1; i < nthreads; i++) {
+            walk_range &r = ranges[(t + i) % nthreads];
+            {
+                std::lock_guard<std::mutex> lock(r.mtx);
+                if(r.begin == r.end) continue;
+                lo = r.begin + (r.end - r.begin) / 2, hi = r.end;
+                r.end = lo;
+            }
+            /* the own range is empty, the victim's lock is released first so two thieves never wait on each other */
+            size_t chunk = chunk_size(hi - lo);
+            {
+                std::lock_guard<std::mutex> lock(ranges[t].mtx);
+                ranges[t].begin = lo + chunk, ranges[t].end = hi;
+            }
+            hi = lo + chunk;
+            __atomic_add_fetch(&nsteals, 1, __ATOMIC_RELAXED);
+            return true;
+        }
+        return false;
+    }
+};
+
+#endif
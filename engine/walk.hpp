@@ -2,15 +2,25 @@
 #define _GRAPH_WALK_H_
 
 #include <algorithm>
+#include <vector>
+#include <omp.h>
 #include "api/types.hpp"
 #include "api/graph_buffer.hpp"
+#include "api/thread_counter.hpp"
+#include "util/random.hpp"
+#include "util/timer.hpp"
 #include "cache.hpp"
+#include "path.hpp"
+#include "spill.hpp"
+#include "pipeline.hpp"
 
-walk_t walk_encode(hid_t hop, vid_t curr, vid_t source) {
+walk_t walk_encode(hid_t hop, vid_t curr, vid_t source, wid_t id) {
     walk_t walk;
     walk.hop   = hop;
     walk.pos    = curr & 0xffffff;
     walk.source = source & 0xffffff;
+    walk.prev   = curr;
+    walk.id     = id;
     return walk;
 }
 
@@ -20,67 +30,137 @@ walk_t walk_recode(walk_t walk, hid_t hop, vid_t curr) {
     return walk;
 }
 
+/**
+ * sort the `n` walks of the block [start_vert, start_vert + nverts) by pos with a parallel counting sort,
+ * the block offsets are shifted into at most `WALK_SORT_BUCKETS` buckets. Each thread counts a static
+ * range of walks, the per thread counts are summed bucket by bucket, and each thread scatters its range
+ * to the offsets of its counts. Walks in one bucket keep their order, walks of nearby vertices end up
+ * together so that their `beg_pos` and `csr` reads share cache lines and pages.
+ */
+void sort_walks_by_pos(walk_t *walks, size_t n, vid_t start_vert, vid_t nverts, tid_t nthreads) {
+    if(n < 2 || nverts < 2) return;
+    unsigned shift = 0;
+    while((nverts >> shift) >= WALK_SORT_BUCKETS) shift++;
+    size_t nbuckets = ((nverts - 1) >> shift) + 1;
+    walk_t *copy = (walk_t*)malloc(n * sizeof(walk_t));
+    std::vector<size_t> counts(nthreads * nbuckets, 0);
+    uint32_t base = start_vert & 0xffffff;
+    auto bucket = [&](const walk_t& w) {
+        uint32_t off = (w.pos - base) & 0xffffff;
+        return (size_t)(min_value(off, nverts - 1) >> shift);
+    };
+
+    #pragma omp parallel num_threads(nthreads)
+    {
+        tid_t t = omp_get_thread_num(), nt = omp_get_num_threads();
+        size_t lo = n * t / nt, hi = n * (t + 1) / nt;
+        size_t *count = counts.data() + t * nbuckets;
+        memcpy(copy + lo, walks + lo, (hi - lo) * sizeof(walk_t));
+        for(size_t i = lo; i < hi; i++) count[bucket(copy[i])]++;
+        #pragma omp barrier
+        #pragma omp single
+        {
+            size_t sum = 0;
+            for(size_t b = 0; b < nbuckets; b++) {
+                for(tid_t r = 0; r < nt; r++) {
+                    size_t c = counts[r * nbuckets + b];
+                    counts[r * nbuckets + b] = sum;
+                    sum += c;
+                }
+            }
+        }
+        for(size_t i = lo; i < hi; i++) walks[count[bucket(copy[i])]++] = copy[i];
+    }
+    free(copy);
+}
+
 class graph_walk {
 public:
     vid_t nvertices;
     eid_t nedges;
     tid_t nthreads;     /* number of threads */
+    uint64_t seed;      /* the run seed */
     graph_block *global_blocks;
+    rand_t rng;         /* the scheduler random stream, only used by the main thread */
 
-    std::vector<hid_t> maxhops;   /* record the block has at least `maxhops` to finished */
-    std::vector<std::vector<wid_t>>     block_nmwalk;  /* record each block number of walks in memroy */
-    std::vector<std::vector<wid_t>>     block_ndwalk;  /* record each block number of walks in disk */
-    std::vector<int>       block_desc;     /* the descriptor of each block walk file */
+    thread_counter<hid_t> maxhops;       /* record the block has at least `maxhops` to finished */
+    thread_counter<wid_t> block_nmwalk;  /* record each block number of walks in memroy */
+    thread_counter<wid_t> block_ndwalk;  /* record each block number of walks in disk */
+    walk_store            *store;         /* the walks spilled to disk */
+    std::vector<walk_codec> codecs;       /* the spill encoder of each thread and the loader last, empty when walks spill raw */
+    std::vector<spill_stat> spills;       /* the spill statistics of each thread */
+    double load_seconds;                  /* the seconds spent reading and decoding the spilled walks */
+    walk_pipeline         *pipeline;      /* the background walk load and spill stages, NULL when they run inline */
+    std::vector<uint8_t>   staged;        /* the spilled bytes of the loading block handed over by the pipeline */
     graph_buffer<walk_t> **block_walks;   /* the walk resident in memory */
     graph_buffer<walk_t>   walks;         /* the walks in cuurent block */
 
     graph_driver *global_driver;
+    graph_cache  *global_cache;           /* the cached blocks, set by the engine */
+    path_recorder *paths;                 /* records every step when set */
+    std::vector<cache_block*> resident;   /* the cache slot of each block executing in a multi-block pass, NULL otherwise */
+    std::vector<std::vector<walk_t> > handoff;  /* the walks each thread moved into a resident block */
     std::string base_name;                /* the dataset base name */
 
     graph_walk(graph_config& conf, graph_block & blocks, graph_driver &driver) {
+        if(conf.nvertices > MAX_VERTICES) {
+            logstream(LOG_FATAL) << "the graph has " << conf.nvertices << " vertices, a walk addresses at most " << MAX_VERTICES << std::endl;
+        }
         nvertices = conf.nvertices;
         nedges    = conf.nedges;
         nthreads = conf.nthreads;
+        seed      = conf.seed;
+        rng.seed(seed, 0xffffffffffffffffULL, 0);
         global_blocks = &blocks;
         base_name = conf.base_name;
 
-        maxhops.resize(global_blocks->nblocks, 0);
-
-        block_nmwalk.resize(global_blocks->nblocks);
-        for(bid_t blk = 0; blk < global_blocks->nblocks; blk++) {
-            block_nmwalk[blk].resize(nthreads);
-            std::fill(block_nmwalk[blk].begin(), block_nmwalk[blk].end(), 0);
-        }
+        maxhops.alloc(nthreads, global_blocks->nblocks);
+        block_nmwalk.alloc(nthreads, global_blocks->nblocks);
+        block_ndwalk.alloc(nthreads, global_blocks->nblocks);
 
-        block_ndwalk.resize(global_blocks->nblocks);
-        for(bid_t blk = 0; blk < global_blocks->nblocks; blk++) {
-            block_ndwalk[blk].resize(nthreads);
-            std::fill(block_ndwalk[blk].begin(), block_ndwalk[blk].end(), 0);
-        }
+        store = new walk_store(conf.base_name, global_blocks->nblocks, &driver);
+        pipeline = conf.pipeline ? new walk_pipeline(store, global_blocks->nblocks) : NULL;
+        if(conf.pack_walks) codecs.resize(nthreads + 1);
+        spill_stat zero;
+        memset(&zero, 0, sizeof(spill_stat));
+        spills.assign(nthreads, zero);
+        load_seconds = 0.0;
 
-        block_desc.resize(global_blocks->nblocks);
-        for(bid_t blk = 0; blk < global_blocks->nblocks; blk++) { 
-            std::string walk_name = get_walk_name(conf.base_name, blk);
-            block_desc[blk] = open(walk_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, S_IROTH | S_IWOTH | S_IWUSR | S_IRUSR);
-        }
-        
         block_walks = (graph_buffer<walk_t> **)malloc(global_blocks->nblocks * sizeof(graph_buffer<wid_t> *));
         for(bid_t blk = 0; blk < global_blocks->nblocks; blk++) {
             block_walks[blk] = (graph_buffer<walk_t> *)malloc(nthreads * sizeof(graph_buffer<walk_t>));
             for(tid_t tid = 0; tid < nthreads; tid++) {
-                block_walks[blk][tid].alloc(MAX_TWALKS);
+                block_walks[blk][tid].alloc(conf.twalks);
             }
         }
 
         global_driver = &driver;
+        global_cache  = NULL;
+        paths         = NULL;
+        resident.assign(global_blocks->nblocks, NULL);
+        handoff.resize(nthreads);
     }
 
     ~graph_walk() {
-        for(bid_t blk = 0; blk < global_blocks->nblocks; blk++) {
-            close(block_desc[blk]);
-            std::string walk_name = get_walk_name(base_name, blk);
-            unlink(walk_name.c_str());
+        spill_stat total;
+        memset(&total, 0, sizeof(spill_stat));
+        for(tid_t t = 0; t < nthreads; t++) {
+            total.walks += spills[t].walks, total.bytes += spills[t].bytes, total.seconds += spills[t].seconds;
         }
+        if(total.walks > 0) {
+            double mb = (double)total.walks * sizeof(walk_t) / (1024.0 * 1024.0);
+            double spill_seconds = total.seconds;
+            if(pipeline) {
+                /* the threads only queued the batches, the spill stage wrote them */
+                std::lock_guard<std::mutex> lock(pipeline->mtx);
+                spill_seconds = pipeline->spill_busy;
+            }
+            logstream(LOG_INFO) << "walk spills : " << total.walks << " walks, " << (codecs.empty() ? "raw" : "packed") << " "
+                                << (double)total.bytes / total.walks << " bytes per walk, spill " << mb / spill_seconds
+                                << " MB/s, load " << mb / load_seconds << " MB/s of walk records" << std::endl;
+        }
+        delete pipeline;
+        delete store;
 
         for(bid_t blk = 0; blk < global_blocks->nblocks; blk++) {
             for(tid_t tid = 0; tid < nthreads; tid++) {
@@ -92,20 +172,35 @@ public:
     }
 
     void move_walk(walk_t oldwalk, bid_t blk, tid_t t, vid_t dst, hid_t hop) {
-        block_nmwalk[blk][t] += 1;
         walk_t newwalk = walk_recode(oldwalk, hop, dst);
+        if(resident[blk]) {
+            handoff[t].push_back(newwalk);
+            return;
+        }
+        block_nmwalk.at(t, blk) += 1;
         block_walks[blk][t].push_back(newwalk);
-        global_blocks->update_rank(dst);
+        global_blocks->update_rank(blk, t);
         if(block_walks[blk][t].full()) {
             persistent_walks(t, blk);
         }
     }
 
     void persistent_walks(tid_t t, bid_t blk) {
-        block_ndwalk[blk][t] += block_walks[blk][t].size();
-        block_nmwalk[blk][t] -= block_walks[blk][t].size();
-        global_driver->dump_walk(block_desc[blk], block_walks[blk][t]);
+        graph_timer timer;
+        timer.start_time();
+        wid_t n = block_walks[blk][t].size();
+        block_ndwalk.at(t, blk) += n;
+        block_nmwalk.at(t, blk) -= n;
+        size_t bytes = n * sizeof(walk_t);
+        const void *buf = block_walks[blk][t].buffer_begin();
+        if(!codecs.empty()) {
+            bytes = codecs[t].encode(block_walks[blk][t].buffer_begin(), n, global_blocks->blocks[blk].start_vert);
+            buf = codecs[t].data.data();
+        }
+        if(pipeline) pipeline->spill(blk, buf, bytes);
+        else store->append(blk, buf, bytes);
         block_walks[blk][t].clear();
+        spills[t].walks += n, spills[t].bytes += bytes, spills[t].seconds += timer.runtime();
     }
 
     wid_t nwalks() {
@@ -128,33 +223,54 @@ public:
     }
 
     wid_t nblockwalks(bid_t blk) {
-        wid_t walksum = 0;
-        for(tid_t t = 0; t < nthreads; t++) {
-            walksum += block_nmwalk[blk][t] + block_ndwalk[blk][t];
-        }
-        return walksum;
+        return block_nmwalk.reduce(blk) + block_ndwalk.reduce(blk);
     }
 
     wid_t nmwalks(bid_t exec_block) {
-        wid_t walksum = 0;
-        for(tid_t t = 0; t < nthreads; t++) {
-            walksum += block_nmwalk[exec_block][t];
-        }
-        return walksum;
+        return block_nmwalk.reduce(exec_block);
     }
 
     wid_t ndwalks(bid_t exec_block) { 
-        wid_t walksum = 0;
-        for(tid_t t = 0; t < nthreads; t++) {
-            walksum += block_ndwalk[exec_block][t];
-        }
-        return walksum;
+        return block_ndwalk.reduce(exec_block);
     }
 
     void load_walks(bid_t exec_block) {
+        walks.alloc(this->nblockwalks(exec_block));
+        append_walks(exec_block);
+    }
+
+    /** append the walks of `exec_block` to `walks`, the spilled ones first */
+    void append_walks(bid_t exec_block) {
         wid_t mwalk_count = this->nmwalks(exec_block), dwalk_count = this->ndwalks(exec_block);
-        walks.alloc(mwalk_count + dwalk_count);
-        global_driver->load_walk(block_desc[exec_block], dwalk_count, walks);
+        size_t first = walks.size();
+        walk_t *out = walks.buffer_begin() + first;
+        graph_timer timer;
+        timer.start_time();
+        size_t bytes;
+        const uint8_t *data = NULL;
+        if(pipeline) {
+            bytes = pipeline->take(exec_block, staged);
+            data  = staged.data();
+        } else {
+            bytes = store->size(exec_block);
+        }
+        if(codecs.empty()) {
+            assert(bytes == dwalk_count * sizeof(walk_t));
+            if(data) memcpy(out, data, bytes);
+            else store->load(exec_block, out);
+        } else if(bytes > 0) {
+            /* the batches are decoded from the loader's buffer, with slack for the group varint decoder */
+            walk_codec &loader = codecs[nthreads];
+            if(!data) {
+                loader.data.resize(bytes + GV_PADDING);
+                store->load(exec_block, loader.data.data());
+                data = loader.data.data();
+            }
+            size_t n = loader.decode(data, bytes, global_blocks->blocks[exec_block].start_vert, out);
+            assert(n == dwalk_count);
+        }
+        walks.set_size(first + dwalk_count);
+        load_seconds += timer.runtime();
         
         /** load the in-memory */
         for(tid_t t = 0; t < nthreads; t++) {
@@ -163,14 +279,20 @@ public:
                 walks.push_back(block_walks[exec_block][t][w]);
             }
         }
-        assert(walks.size() == mwalk_count + dwalk_count);
+        assert(walks.size() == first + mwalk_count + dwalk_count);
     }
 
     void dump_walks(bid_t exec_block) {
         walks.destroy();
-        std::fill(block_ndwalk[exec_block].begin(), block_ndwalk[exec_block].end(), 0);
-        std::fill(block_nmwalk[exec_block].begin(), block_nmwalk[exec_block].end(), 0);
-        ftruncate(block_desc[exec_block], 0);
+        release_walks(exec_block);
+    }
+
+    /** forget the walks of `exec_block` once they are loaded, and return its spilled segments */
+    void release_walks(bid_t exec_block) {
+        block_ndwalk.reset(exec_block);
+        block_nmwalk.reset(exec_block);
+        maxhops.reset(exec_block);
+        store->release(exec_block);
         global_blocks->reset_rank(exec_block);
 
         /* clear the in-memory walks */
@@ -179,6 +301,12 @@ public:
         }
     }
 
+    /** sort the loaded walks of `exec_block`, from `first` on, by pos */
+    void sort_walks(bid_t exec_block, size_t first = 0) {
+        sort_walks_by_pos(walks.buffer_begin() + first, walks.size() - first, global_blocks->blocks[exec_block].start_vert,
+                          global_blocks->blocks[exec_block].nverts, nthreads);
+    }
+
     bool test_finished_walks() {
         return this->nwalks() == 0;
     }
@@ -200,19 +328,18 @@ public:
         return blk;
     }
 
-    void set_max_hop(bid_t blk, hid_t hop) {
-        #pragma omp critical
-        {
-            if(maxhops[blk] < hop) maxhops[blk] = hop;
-        }
+    void set_max_hop(bid_t blk, tid_t t, hid_t hop) {
+        hid_t &maxhop = maxhops.at(t, blk);
+        if(maxhop < hop) maxhop = hop;
     }
 
     bid_t max_hops_block() { 
         hid_t walk_hop = 0;
         bid_t blk = 0;
         for(bid_t p = 0; p < global_blocks->nblocks; p++) {
-            if(maxhops[p] > walk_hop) {
-                walk_hop = maxhops[p];
+            hid_t hop = maxhops.reduce_max(p);
+            if(hop > walk_hop) {
+                walk_hop = hop;
                 blk = p;
             }
         }
@@ -221,7 +348,7 @@ public:
     }
 
     bid_t choose_block(float prob) {
-        float cc = (float)rand() / RAND_MAX;
+        float cc = rng.gen_float();
         if(cc < prob) return max_hops_block();
         else return max_walks_block();
     }
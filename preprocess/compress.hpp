@@ -0,0 +1,76 @@
+#ifndef _GRAPH_COMPRESS_H_
+#define _GRAPH_COMPRESS_H_
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include "api/types.hpp"
+#include "logger/logger.hpp"
+#include "util/util.hpp"
+#include "util/io.hpp"
+#include "util/codec.hpp"
+
+/**
+ * This file defines the compressed csr block format. Each block of the `.csr` file is stored in
+ * `.zcsr` as the group varint encoding of its delta coded neighbors: the first neighbor of a vertex
+ * is kept as is, the others as the gap to the previous one (the converter sorts the neighbors).
+ * `.zidx` records the byte offset of each block in `.zcsr`, and the block degrees come from `.deg`,
+ * so a block is loaded with one read of `.deg` and one read of `.zcsr`, then decoded in memory.
+ */
+
+/** write `.zcsr` and `.zidx` for the blocks of the given split, return the compressed size in bytes */
+size_t compress_blocks(const std::string& filename, int fnum, size_t blocksize) {
+    std::string vert_block_name = get_vert_blocks_name(filename, blocksize);
+    std::string edge_block_name = get_edge_blocks_name(filename, blocksize);
+    std::string degree_name     = get_degree_name(filename, fnum);
+    std::string csr_name        = get_csr_name(filename, fnum);
+    std::string zcsr_name       = get_compressed_csr_name(filename, fnum);
+    std::string zidx_name       = get_compressed_index_name(filename, blocksize);
+
+    std::vector<vid_t> vblocks = load_graph_blocks<vid_t>(vert_block_name);
+    std::vector<eid_t> eblocks = load_graph_blocks<eid_t>(edge_block_name);
+
+    int vertdesc = open(degree_name.c_str(), O_RDONLY);
+    int edgedesc = open(csr_name.c_str(), O_RDONLY);
+    assert(vertdesc >= 0 && edgedesc >= 0);
+    test_delete(zcsr_name);
+
+    bid_t nblocks = vblocks.size() - 1;
+    std::vector<eid_t> offsets(1, 0);
+    vid_t *degree = NULL, *csr = NULL;
+    uint8_t *buf = NULL;
+    for(bid_t blk = 0; blk < nblocks; blk++) {
+        vid_t nverts = vblocks[blk+1] - vblocks[blk];
+        eid_t nedges = eblocks[blk+1] - eblocks[blk];
+
+        degree = (vid_t*)realloc(degree, max_value(nverts, 1) * sizeof(vid_t));
+        csr    = (vid_t*)realloc(csr, max_value(nedges, 1) * sizeof(vid_t));
+        buf    = (uint8_t*)realloc(buf, gv_max_bytes(nedges) + 1);
+        assert(degree != NULL && csr != NULL && buf != NULL);
+        load_block_range(vertdesc, degree, nverts, vblocks[blk] * sizeof(vid_t));
+        load_block_range(edgedesc, csr,    nedges, eblocks[blk] * sizeof(vid_t));
+
+        delta_encode_block(degree, nverts, csr);
+        size_t bytes = gv_encode(csr, nedges, buf);
+        appendfile(zcsr_name, buf, bytes);
+        offsets.push_back(offsets.back() + bytes);
+        logstream(LOG_INFO) << "compress block " << blk << " : " << nedges * sizeof(vid_t) << " bytes -> " << bytes << " bytes" << std::endl;
+    }
+
+    auto zidx = std::fstream(zidx_name.c_str(), std::ios::out | std::ios::binary);
+    zidx.write((char*)&offsets[0], offsets.size() * sizeof(eid_t));
+    zidx.close();
+
+    size_t raw = eblocks.back() * sizeof(vid_t) + (size_t)vblocks.back() * sizeof(eid_t);
+    size_t compressed = offsets.back() + (size_t)vblocks.back() * sizeof(vid_t);
+    logstream(LOG_INFO) << "compressed blocks : " << raw << " bytes -> " << compressed << " bytes, ratio = " << (double)compressed / max_value(raw, (size_t)1) << std::endl;
+
+    if(degree) free(degree);
+    if(csr)    free(csr);
+    if(buf)    free(buf);
+    close(vertdesc);
+    close(edgedesc);
+    return compressed;
+}
+
+#endif
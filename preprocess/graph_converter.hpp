@@ -4,6 +4,8 @@
 #include <string>
 #include <vector>
 #include <fstream>
+#include <algorithm>
+#include <functional>
 #include "api/graph_buffer.hpp"
 #include "api/constants.hpp"
 #include "api/types.hpp"
@@ -11,8 +13,14 @@
 #include "util/util.hpp"
 #include "util/io.hpp"
 #include "precompute.hpp"
+#include "parser.hpp"
+#include "importer.hpp"
+#include "reorder.hpp"
+#include "partition.hpp"
+#include "util/external_sort.hpp"
 
 size_t split_blocks(const std::string& filename, int fnum, size_t block_size = BLOCK_SIZE);
+double compute_graph_degree_ratio(const std::string& filename, int fnum, size_t blocksize = BLOCK_SIZE);
 
 /** This file defines the data structure that contribute to convert the text format graph to some specific format */
 
@@ -43,6 +51,8 @@ class graph_converter : public base_converter {
 private:
     int fnum;
     bool _weighted;
+    size_t blocksize;       /* the block size the output folder is named after */
+    size_t edge_size;       /* the edges the csr buffer holds, the largest degree it takes */
     graph_buffer<eid_t> beg_pos;
     graph_buffer<vid_t> csr;
     graph_buffer<vid_t> deg;
@@ -62,15 +72,15 @@ private:
     std::string output_filename;
 
     void setup_output(const std::string& input) {
-        std::string folder = randgraph_output_folder(get_path_name(input), BLOCK_SIZE);
+        std::string folder = randgraph_output_folder(get_path_name(input), blocksize);
         if(!test_folder_exists(folder)) randgraph_mkdir(folder.c_str());
-        output_filename = randgraph_output_filename(get_path_name(input), get_file_name(input), BLOCK_SIZE);
+        output_filename = randgraph_output_filename(get_path_name(input), get_file_name(input), blocksize);
     }
 
     void setup_output(const std::string& path, const std::string& dataset) {
-        std::string folder = randgraph_output_folder(path, BLOCK_SIZE);
+        std::string folder = randgraph_output_folder(path, blocksize);
         if(!test_folder_exists(folder)) randgraph_mkdir(folder.c_str());
-        output_filename = randgraph_output_filename(path, dataset, BLOCK_SIZE);
+        output_filename = randgraph_output_filename(path, dataset, blocksize);
     }
 
     void flush_beg_pos() {
@@ -105,7 +115,20 @@ private:
         weights.clear();
     }
 
+    /** sort the current vertex neighbors, keep the weights along, so the compressed blocks can be delta coded */
+    void sort_adj() {
+        if(!_weighted) {
+            std::sort(adj.begin(), adj.end());
+            return;
+        }
+        std::vector<std::pair<vid_t, real_t>> edges(adj.size());
+        for(size_t i = 0; i < adj.size(); i++) edges[i] = std::make_pair(adj[i], adj_weights[i]);
+        std::sort(edges.begin(), edges.end());
+        for(size_t i = 0; i < adj.size(); i++) adj[i] = edges[i].first, adj_weights[i] = edges[i].second;
+    }
+
     void sync_buffer() {
+        sort_adj();
         for(auto & dst : adj) csr.push_back(dst);
         if(_weighted) {
             for(const auto & w : adj_weights) weights.push_back(w);
@@ -126,6 +149,8 @@ public:
     graph_converter() = delete;
     graph_converter(const std::string& path, bool weighted = false) {
         fnum = 0;
+        blocksize = BLOCK_SIZE;
+        edge_size = EDGE_SIZE;
         beg_pos.alloc(VERT_SIZE);
         csr.alloc(EDGE_SIZE);
         deg.alloc(VERT_SIZE);
@@ -138,6 +163,8 @@ public:
     }
     graph_converter(const std::string& folder, const std::string& dataset, bool weighted = false) {
         fnum = 0;
+        blocksize = BLOCK_SIZE;
+        edge_size = EDGE_SIZE;
         beg_pos.alloc(VERT_SIZE);
         csr.alloc(EDGE_SIZE);
         deg.alloc(VERT_SIZE);
@@ -148,8 +175,10 @@ public:
             weights.alloc(EDGE_SIZE);
         }
     }
-    graph_converter(const std::string& path, size_t vert_size, size_t edge_size, bool weighted = false) {
+    graph_converter(const std::string& path, size_t vert_size, size_t edge_buffer, size_t block_size, bool weighted = false) {
         fnum = 0;
+        blocksize = block_size;
+        edge_size = edge_buffer;
         beg_pos.alloc(vert_size);
         csr.alloc(edge_size);
         deg.alloc(vert_size);
@@ -157,7 +186,7 @@ public:
         setup_output(path);
         _weighted = weighted;
         if(_weighted) {
-            weights.alloc(EDGE_SIZE);
+            weights.alloc(edge_size);
         }
     }
     ~graph_converter() {
@@ -167,17 +196,28 @@ public:
     }
 
     void initialize() {
+        fnum = 0;
         beg_pos.clear();
         csr.clear();
         deg.clear();
+        if(_weighted) weights.clear();
+        adj.clear();
+        adj_weights.clear();
         curr_vert = max_vert = buf_vstart = buf_estart = rd_edges = csr_pos = 0;
         beg_pos.push_back(0);
     }
 
     void convert(vid_t from, vid_t to, real_t *weight) {
+        if(from >= MAX_VERTICES || to >= MAX_VERTICES) {
+            logstream(LOG_FATAL) << "vertex id " << max_value(from, to) << " is out of the " << MAX_VERTICES << " vertices a walk can address" << std::endl;
+        }
         max_vert = max_value(max_vert, from);
         max_vert = max_value(max_vert, to);
 
+        if(from < curr_vert) {
+            logstream(LOG_ERROR) << "The edges are not grouped by source, vertex " << from << " follows " << curr_vert << ", convert with sort=1" << std::endl;
+            assert(false);
+        }
         if(from == curr_vert) {
             adj.push_back(to);
             if(_weighted) adj_weights.push_back(*weight);
@@ -186,8 +226,8 @@ public:
             if(csr.test_overflow(adj.size()) || beg_pos.full() ) {
                 flush_buffer();
             }
-            if(adj.size() > EDGE_SIZE) {
-                logstream(LOG_ERROR) << "Too small memory capacity with EDGE_SIZE = " << EDGE_SIZE << " to support larger out degree = " << adj.size() << std::endl;
+            if(adj.size() > edge_size) {
+                logstream(LOG_ERROR) << "Too small memory capacity with " << edge_size << " buffered edges to support larger out degree = " << adj.size() << ", raise memory=" << std::endl;
                 assert(false);
             }
             sync_buffer();
@@ -210,6 +250,11 @@ public:
         if(_weighted && !weights.empty()) flush_weights();
     }
 
+    /** keep at least `nvertices` vertices, the ones after the last edge are isolated, call before `finalize` */
+    void pad_vertices(vid_t nvertices) {
+        if(nvertices > 0) max_vert = max_value(max_vert, nvertices - 1);
+    }
+
     void finalize() {
         sync_buffer();
         if(max_vert > curr_vert) sync_zeros(max_vert - curr_vert);
@@ -223,41 +268,147 @@ public:
     bool is_weighted() const { return _weighted; }
 };
 
-void convert(std::string filename, graph_converter &converter, size_t blocksize = BLOCK_SIZE) {
+/**
+ * the converter buffers for a `budget` of bytes: half of it holds vertices and edges in the ratio of
+ * `VERT_SIZE` to `EDGE_SIZE`, up to those sizes, and the other half is the run buffer of the external sort.
+ */
+inline void plan_convert_memory(size_t budget, bool weighted, size_t &vert_size, size_t &edge_size, size_t &sort_memory) {
+    size_t ratio = (size_t)(EDGE_SIZE) / (VERT_SIZE);
+    size_t unit = sizeof(eid_t) + sizeof(vid_t) + ratio * (sizeof(vid_t) + (weighted ? sizeof(real_t) : 0));
+    vert_size = min_value(budget / 2 / unit, (size_t)VERT_SIZE);
+    edge_size = vert_size * ratio;
+    sort_memory = budget / 2;
+    logstream(LOG_INFO) << "memory plan : " << (budget >> 20) << "MB, converter buffers of " << vert_size << " vertices and " << edge_size
+                        << " edges, sort runs of " << (sort_memory >> 20) << "MB" << std::endl;
+}
+
+/** the options of `convert` */
+struct convert_options {
+    bool sort;              /* the edges are not grouped by source, sort them externally before converting */
+    bool dedup;             /* drop the duplicate edges, the weight of an arbitrary one of them is kept, implies sort */
+    size_t sort_memory;     /* the run buffer size of the external sort in bytes */
+    std::string format;     /* the input format, see `import_edges` */
+    std::string reorder;    /* the vertex order, `none`, `degree` or `bfs`, see `compute_order` */
+    std::string partition;  /* the block split, `edges` by edge count or `locality`, see `split_blocks_locality` */
+    double partition_fill;  /* the least fill of a `locality` block */
+    vid_t hubs;             /* the number of vertices in the pinned hub block, see `write_hub_block` */
+
+    convert_options() {
+        format = "text";
+        reorder = "none";
+        partition = "edges";
+        partition_fill = 0.5;
+        hubs = 0;
+        sort = dedup = false;
+        sort_memory = SORT_MEMORY;
+    }
+};
 
-    FILE *fp = fopen(filename.c_str(), "r");
-    assert(fp != NULL);
+struct edge_less {
+    bool operator()(const edge_t& a, const edge_t& b) const {
+        return a.from < b.from || (a.from == b.from && a.to < b.to);
+    }
+};
+
+/**
+ * feed the edges produced by `produce(sink)` to the converter. With `opts.sort` the edges go through
+ * the external sorter first, its runs are spilled next to the output files. The graph has at least
+ * `nvertices` vertices, so trailing isolated vertices are kept.
+ */
+template<typename producer_t>
+void convert_edges(graph_converter &converter, const convert_options& opts, producer_t produce, vid_t nvertices = 0) {
+    bool weighted = converter.is_weighted();
+    auto feed = [&converter, weighted](const edge_t& e) {
+        real_t w = e.weight;
+        converter.convert(e.from, e.to, weighted ? &w : NULL);
+    };
 
     converter.initialize();
-    char line[1024];
-    while(fgets(line, 1024, fp) != NULL) {
-        if(line[0] == '#') continue;
-        if(line[0] == '%') continue;
-
-        char *t1, *t2, *t3;
-        t1 = strtok(line, "\t, ");
-        t2 = strtok(NULL, "\t, ");
-        t3 = strtok(NULL, "\t, ");
-        if(t1 == NULL || t2 == NULL) {
-            logstream(LOG_ERROR) << "Input file is not the right format. Expected <from> <to>" << std::endl;
-            assert(false);
-        }
-        vid_t from = atoi(t1);
-        vid_t to = atoi(t2);
-        if(from == to) continue;
-        if(converter.is_weighted()) {
-            assert(t3 != NULL);
-            real_t w = static_cast<real_t>(atof(t3));
-            converter.convert(from, to, &w);
-        }else {
-            converter.convert(from, to, NULL);
-        }
+    if(!opts.sort && !opts.dedup) {
+        produce(feed);
+    } else {
+        external_sorter<edge_t, edge_less> sorter(converter.get_output_filename() + "_sort", opts.sort_memory);
+        produce([&sorter](const edge_t& e) { sorter.add(e); });
+
+        bool dedup = opts.dedup, first = true;
+        edge_t last;
+        size_t ndups = 0;
+        sorter.merge([&](const edge_t& e) {
+            if(dedup && !first && e.from == last.from && e.to == last.to) {
+                ndups++;
+                return;
+            }
+            first = false;
+            last = e;
+            feed(e);
+        });
+        if(dedup) logstream(LOG_INFO) << "removed " << ndups << " duplicate edges" << std::endl;
     }
+    converter.pad_vertices(nvertices);
     converter.finalize();
+}
+
+/** split the converted graph into blocks with the partitioner of `opts.partition` */
+size_t split_graph(const std::string& base, size_t blocksize, const convert_options& opts) {
+    if(opts.partition == "edges") return split_blocks(base, 0, blocksize);
+    if(opts.partition == "locality") {
+        size_t nblocks = split_blocks_locality(base, 0, blocksize, opts.partition_fill);
+        compute_graph_degree_ratio(base, 0, blocksize);
+        return nblocks;
+    }
+    logstream(LOG_ERROR) << "unknown partition " << opts.partition << ", expected edges or locality" << std::endl;
+    assert(false);
+    return 0;
+}
+
+/**
+ * renumber the converted graph by `opts.reorder` : the csr is moved aside, the relabeled edges are sorted
+ * and converted again, and the blocks are split again. The isolated vertices are ordered last and padded
+ * back, so the graph keeps the vertex count of `.perm`. The in-block ratio is reported before and after.
+ */
+void reorder_graph(graph_converter &converter, size_t blocksize, const convert_options& opts) {
+    std::string base = converter.get_output_filename();
+    std::string orig = base + "_orig";
+    bool weighted = converter.is_weighted();
+    double before = compute_graph_degree_ratio(base, 0, blocksize);
+    std::vector<vid_t> order = compute_order(base, opts.reorder);
+
+    rename(get_beg_pos_name(base, 0).c_str(), get_beg_pos_name(orig, 0).c_str());
+    rename(get_csr_name(base, 0).c_str(), get_csr_name(orig, 0).c_str());
+    test_delete(get_degree_name(base, 0));
+    if(weighted) rename(get_weights_name(base, 0).c_str(), get_weights_name(orig, 0).c_str());
+
+    convert_options relabel = opts;
+    relabel.sort  = true;
+    relabel.dedup = false;
+    convert_edges(converter, relabel, [&orig, &order, weighted](std::function<void(const edge_t&)> sink) {
+        relabel_edges(orig, order, weighted, sink);
+    }, order.size());
+    test_delete(get_beg_pos_name(orig, 0));
+    test_delete(get_csr_name(orig, 0));
+    if(weighted) test_delete(get_weights_name(orig, 0));
+
+    split_graph(base, blocksize, opts);
+    double after = compute_graph_degree_ratio(base, 0, blocksize);
+    logstream(LOG_INFO) << "reorder by " << opts.reorder << " : in-block ratio " << before << " -> " << after << std::endl;
+}
+
+void convert(std::string filename, graph_converter &converter, size_t blocksize = BLOCK_SIZE, const convert_options& opts = convert_options()) {
+    bool weighted = converter.is_weighted();
+    convert_edges(converter, opts, [&filename, &opts, weighted](std::function<void(const edge_t&)> sink) {
+        import_edges(filename, opts.format, weighted, sink);
+    });
 
     /* split the data into multiple blocks */
-    split_blocks(converter.get_output_filename(), 0, blocksize);
-    
+    split_graph(converter.get_output_filename(), blocksize, opts);
+
+    if(opts.reorder != "none") {
+        reorder_graph(converter, blocksize, opts);
+    }
+
+    if(opts.hubs > 0) write_hub_block(converter.get_output_filename(), 0, opts.hubs);
+    else remove_hub_block(converter.get_output_filename());
+
     /* if the graph is weighted, then preprocess the alias table. */
     if(converter.is_weighted()) {
         second_order_precompute(converter.get_output_filename(), 0, blocksize);
@@ -309,30 +460,13 @@ size_t split_blocks(const std::string& filename, int fnum, size_t block_size) {
     rd_edges = beg_pos[rv-1];
     eblocks.push_back(rd_edges);
 
-    /** write the vertex split points into vertex block file */
-    std::string vblockfile = get_vert_blocks_name(filename, block_size);
-    auto vblf = std::fstream(vblockfile.c_str(), std::ios::out | std::ios::binary);
-    vblf.write((char*)&vblocks[0], vblocks.size() * sizeof(vid_t));
-    vblf.close();
-
-    /** write the edge split points into edge block file */
-    std::string eblockfile = get_edge_blocks_name(filename, block_size);
-    auto eblf = std::fstream(eblockfile.c_str(), std::ios::out | std::ios::binary);
-    eblf.write((char*)&eblocks[0], eblocks.size() * sizeof(eid_t));
-    eblf.close();
-
-    /** write the graph meta data into meta file */
-    std::string metafile = get_meta_name(filename);
-    auto metastream = std::fstream(metafile.c_str(), std::ios::out | std::ios::binary);
-    metastream.write((char*)&vblocks.back(), sizeof(vid_t));
-    metastream.write((char*)&eblocks.back(), sizeof(eid_t));
-    metastream.close();
+    write_graph_blocks(filename, block_size, vblocks, eblocks);
 
     return vblocks.size() - 1;
 }
 
-/** compute the given graph each vertex point to the same block ratio */
-void compute_graph_degree_ratio(const std::string& filename, int fnum, size_t blocksize = BLOCK_SIZE) {
+/** compute the given graph each vertex point to the same block ratio, return the average of the vertices with edges */
+double compute_graph_degree_ratio(const std::string& filename, int fnum, size_t blocksize) {
     std::string vert_block_name = get_vert_blocks_name(filename, blocksize);
     std::string edge_block_name = get_edge_blocks_name(filename, blocksize);
     std::string degree_name     = get_degree_name(filename, fnum);
@@ -348,8 +482,11 @@ void compute_graph_degree_ratio(const std::string& filename, int fnum, size_t bl
 
     bid_t nblocks = vblocks.size() - 1;
     logstream(LOG_INFO) << "load vblocks and eblocks successfully, block count : " << nblocks << std::endl;
+    test_delete(output);
     vid_t *degree = NULL, *csr = NULL;
     float *ratio = NULL;
+    double total = 0.0;
+    vid_t nactive = 0;
     for(bid_t blk = 0; blk < nblocks; blk++) {
         vid_t nverts = vblocks[blk+1] - vblocks[blk];
         eid_t nedges = eblocks[blk+1] - eblocks[blk];
@@ -374,6 +511,8 @@ void compute_graph_degree_ratio(const std::string& filename, int fnum, size_t bl
                 if(dst == blk) sum += 1.0 / (float)deg;
             }
             ratio[v] = sum;
+            total += sum;
+            nactive++;
             edge_pos += deg;
         }
         assert(edge_pos == nedges);
@@ -384,6 +523,12 @@ void compute_graph_degree_ratio(const std::string& filename, int fnum, size_t bl
     if(degree) free(degree);
     if(csr)    free(csr);
     if(ratio)  free(ratio);
+    close(vertdesc);
+    close(edgedesc);
+
+    double avg = total / max_value(nactive, (vid_t)1);
+    logstream(LOG_INFO) << "average in-block ratio : " << avg << ", " << nactive << " vertices with edges" << std::endl;
+    return avg;
 }
 
 #endif
@@ -0,0 +1,217 @@
+#ifndef _GRAPH_IMPORTER_H_
+#define _GRAPH_IMPORTER_H_
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include "api/types.hpp"
+#include "logger/logger.hpp"
+#include "util/util.hpp"
+#include "parser.hpp"
+
+/**
+ * This file defines the importers of the graph formats other than the text edge list. Every importer
+ * maps its input and calls `callback(edge)` for each edge like `parse_edges`, so they all feed
+ * `graph_converter` the same way. Self loops are dropped as in the text parser.
+ *
+ * `bin32`, `bin64` : raw records of `<from> <to> [weight]`, the ids are 4 or 8 bytes, the weight a 4 byte float
+ * `mtx`            : Matrix Market coordinate files, the ids are 1-based, `symmetric` files give both directions
+ * `ligra`          : Ligra `AdjacencyGraph` and `WeightedAdjacencyGraph` files
+ *
+ * The binary and Matrix Market inputs are not necessarily grouped by source, convert them with `sort=1`.
+ */
+
+/** read the raw binary edge records of `idbytes` wide ids */
+template<typename callback_t>
+void import_binary_edges(const std::string& filename, size_t idbytes, bool weighted, callback_t callback) {
+    assert(idbytes == 4 || idbytes == 8);
+    input_map input(filename);
+    size_t recbytes = 2 * idbytes + (weighted ? sizeof(float) : 0);
+    if(input.len % recbytes != 0) {
+        logstream(LOG_ERROR) << filename << " is not a list of " << recbytes << " bytes edge records" << std::endl;
+        assert(false);
+    }
+    size_t nedges = input.len / recbytes;
+    logstream(LOG_INFO) << "import " << filename << " : " << nedges << " binary edges, " << idbytes * 8 << " bits ids" << std::endl;
+
+    const char *p = input.data;
+    edge_t e;
+    e.weight = 0.0;
+    for(size_t i = 0; i < nedges; i++, p += recbytes) {
+        uint64_t from = 0, to = 0;
+        memcpy(&from, p, idbytes);
+        memcpy(&to, p + idbytes, idbytes);
+        if(from == to) continue;
+        if(weighted) {
+            float w;
+            memcpy(&w, p + 2 * idbytes, sizeof(float));
+            e.weight = w;
+        }
+        e.from = to_vid(from);
+        e.to   = to_vid(to);
+        callback(e);
+    }
+}
+
+/** read a Matrix Market coordinate file, entry `i j [value]` is the edge `i - 1 -> j - 1` */
+template<typename callback_t>
+void import_matrix_market(const std::string& filename, bool weighted, callback_t callback) {
+    input_map input(filename);
+    const char *p = input.data, *end = input.data + input.len;
+    const char *banner = "%%MatrixMarket";
+    if(input.len < strlen(banner) || strncmp(p, banner, strlen(banner)) != 0) {
+        logstream(LOG_ERROR) << filename << " has no Matrix Market banner" << std::endl;
+        assert(false);
+    }
+    const char *nl = skip_line(p, end);
+    std::string header(p, nl);
+    if(header.find("coordinate") == std::string::npos) {
+        logstream(LOG_ERROR) << "only coordinate Matrix Market files are supported" << std::endl;
+        assert(false);
+    }
+    bool pattern   = header.find("pattern") != std::string::npos;
+    bool symmetric = header.find("symmetric") != std::string::npos || header.find("hermitian") != std::string::npos;
+
+    /* skip the comments, then the size line `rows cols entries` */
+    p = nl;
+    while(p < end && *p == '%') p = skip_line(p, end);
+    uint64_t nrows = 0, ncols = 0, nentries = 0;
+    const char *q = scan_uint(skip_separators(p, end), end, nrows);
+    if(q) q = scan_uint(skip_separators(q, end), end, ncols);
+    if(q) q = scan_uint(skip_separators(q, end), end, nentries);
+    assert(q != NULL);
+    p = skip_line(q, end);
+    logstream(LOG_INFO) << "import " << filename << " : " << nrows << " x " << ncols << ", " << nentries << " entries" << (symmetric ? ", symmetric" : "") << (pattern ? ", pattern" : "") << std::endl;
+
+    bool values = weighted && !pattern;
+    std::vector<size_t> bounds = split_lines(input.data, p - input.data, input.len);
+    parse_parallel<edge_t>(input.data, bounds, [values](const char *p, const char *end, std::vector<edge_t>& edges) {
+        parse_chunk(p, end, values, edges);
+        for(auto & e : edges) {
+            e.from--, e.to--;
+            if(!values) e.weight = 1.0;
+        }
+    }, [symmetric, &callback](const edge_t& e) {
+        callback(e);
+        if(symmetric) {
+            edge_t r = e;
+            std::swap(r.from, r.to);
+            callback(r);
+        }
+    });
+}
+
+/** a token of a Ligra file, the offsets and neighbors are integers, the weights may be decimals */
+struct ligra_token_t {
+    uint64_t u;
+    real_t f;
+};
+
+void parse_ligra_chunk(const char *p, const char *end, std::vector<ligra_token_t>& tokens) {
+    tokens.clear();
+    while(true) {
+        while(p < end && (is_separator(*p) || *p == '\n')) p++;
+        if(p == end) break;
+        ligra_token_t t;
+        const char *q = scan_uint(p, end, t.u);
+        if(q == NULL || (q < end && (*q == '.' || *q == 'e' || *q == 'E'))) {
+            t.u = 0;
+            q = scan_float(p, end, t.f);
+        } else {
+            t.f = (real_t)t.u;
+        }
+        if(q == NULL) {
+            logstream(LOG_ERROR) << "Ligra file has a bad token" << std::endl;
+            assert(false);
+        }
+        tokens.push_back(t);
+        p = q;
+    }
+}
+
+/**
+ * read a Ligra adjacency graph : the header, `n`, `m`, the `n` offsets, the `m` neighbors, and for
+ * the weighted variant the `m` weights. The edges are emitted in csr order, the weighted variant keeps
+ * the neighbors in memory until their weights are read.
+ */
+template<typename callback_t>
+void import_ligra(const std::string& filename, bool weighted, callback_t callback) {
+    input_map input(filename);
+    const char *p = input.data, *end = input.data + input.len;
+    p = skip_separators(p, end);
+    const char *nl = skip_line(p, end);
+    std::string header(p, nl);
+    while(!header.empty() && (header.back() == '\n' || is_separator(header.back()))) header.pop_back();
+    bool has_weights = header == "WeightedAdjacencyGraph";
+    if(!has_weights && header != "AdjacencyGraph") {
+        logstream(LOG_ERROR) << filename << " is not a Ligra adjacency graph, header : " << header << std::endl;
+        assert(false);
+    }
+    if(weighted && !has_weights) {
+        logstream(LOG_ERROR) << filename << " has no weights" << std::endl;
+        assert(false);
+    }
+
+    uint64_t n = 0, m = 0;
+    p = nl;
+    const char *q = scan_uint(skip_separators(p, end), end, n);
+    if(q) q = scan_uint(skip_separators(skip_line(q, end), end), end, m);
+    assert(q != NULL);
+    if(n > 0) to_vid(n - 1);
+    p = skip_line(q, end);
+    logstream(LOG_INFO) << "import " << filename << " : " << header << ", n = " << n << ", m = " << m << std::endl;
+
+    std::vector<eid_t> offsets;
+    offsets.reserve(n + 1);
+    std::vector<vid_t> targets;
+    if(weighted) targets.reserve(m);
+    uint64_t idx = 0;   /* global token index after the header */
+    vid_t src = 0;
+    std::vector<size_t> bounds = split_lines(input.data, p - input.data, input.len);
+    parse_parallel<ligra_token_t>(input.data, bounds, parse_ligra_chunk, [&](const ligra_token_t& t) {
+        if(idx < n) {
+            offsets.push_back(t.u);
+            if(idx + 1 == n) offsets.push_back(m);
+        } else if(idx < n + m) {
+            eid_t e = idx - n;
+            while(src + 1 < n && offsets[src + 1] <= e) src++;
+            if(weighted) {
+                targets.push_back(to_vid(t.u));
+            } else if(src != t.u) {
+                edge_t edge;
+                edge.from = src, edge.to = to_vid(t.u), edge.weight = 0.0;
+                callback(edge);
+            }
+        } else if(weighted && idx < n + 2 * m) {
+            eid_t e = idx - n - m;
+            if(e == 0) src = 0;
+            while(src + 1 < n && offsets[src + 1] <= e) src++;
+            if(src != targets[e]) {
+                edge_t edge;
+                edge.from = src, edge.to = targets[e], edge.weight = t.f;
+                callback(edge);
+            }
+        }
+        idx++;
+    });
+    if(idx < n + m) {
+        logstream(LOG_ERROR) << filename << " is truncated, " << idx << " of " << n + m << " tokens" << std::endl;
+        assert(false);
+    }
+}
+
+/** import `filename` of the given format, `text` is the edge list read by `parse_edges` */
+template<typename callback_t>
+void import_edges(const std::string& filename, const std::string& format, bool weighted, callback_t callback) {
+    if(format == "text") parse_edges(filename, weighted, callback);
+    else if(format == "bin32") import_binary_edges(filename, 4, weighted, callback);
+    else if(format == "bin64") import_binary_edges(filename, 8, weighted, callback);
+    else if(format == "mtx") import_matrix_market(filename, weighted, callback);
+    else if(format == "ligra") import_ligra(filename, weighted, callback);
+    else {
+        logstream(LOG_ERROR) << "unknown input format " << format << ", expected text, bin32, bin64, mtx or ligra" << std::endl;
+        assert(false);
+    }
+}
+
+#endif
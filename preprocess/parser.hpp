@@ -0,0 +1,208 @@
+#ifndef _GRAPH_PARSER_H_
+#define _GRAPH_PARSER_H_
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <cstring>
+#include <limits>
+#include <omp.h>
+#include <sys/mman.h>
+#include "api/constants.hpp"
+#include "api/types.hpp"
+#include "logger/logger.hpp"
+#include "util/util.hpp"
+
+/**
+ * This file defines the parallel text edge list parser. The input is mapped, split into line aligned
+ * chunks, and each window of chunks is parsed on all cores with the hand written scanners below,
+ * while a feeder thread hands the edges of the previous window to the converter in file order.
+ * At most two windows of parsed edges are kept in memory.
+ *
+ * A line is `<from> <to> [weight]`, separated by spaces, tabs or commas. Lines starting with
+ * `#` or `%` are comments.
+ */
+
+struct edge_t {
+    vid_t from, to;
+    real_t weight;
+};
+
+inline bool is_separator(char c) {
+    return c == ' ' || c == '\t' || c == ',' || c == '\r';
+}
+
+inline const char* skip_separators(const char *p, const char *end) {
+    while(p < end && is_separator(*p)) p++;
+    return p;
+}
+
+inline const char* skip_line(const char *p, const char *end) {
+    const char *nl = (const char*)memchr(p, '\n', end - p);
+    return nl ? nl + 1 : end;
+}
+
+/** scan an unsigned integer, return NULL if there is no digit */
+inline const char* scan_uint(const char *p, const char *end, uint64_t &val) {
+    const char *start = p;
+    val = 0;
+    while(p < end && (unsigned)(*p - '0') < 10) {
+        val = val * 10 + (*p - '0');
+        p++;
+    }
+    return p == start ? NULL : p;
+}
+
+/** scan a decimal float such as `-1.5e-3`, return NULL if there is no digit */
+inline const char* scan_float(const char *p, const char *end, real_t &val) {
+    bool neg = false;
+    if(p < end && (*p == '-' || *p == '+')) neg = (*p++ == '-');
+    double v = 0.0;
+    int ndigits = 0;
+    while(p < end && (unsigned)(*p - '0') < 10) v = v * 10 + (*p++ - '0'), ndigits++;
+    if(p < end && *p == '.') {
+        p++;
+        double scale = 0.1;
+        while(p < end && (unsigned)(*p - '0') < 10) v += (*p++ - '0') * scale, scale *= 0.1, ndigits++;
+    }
+    if(ndigits == 0) return NULL;
+    if(p < end && (*p == 'e' || *p == 'E')) {
+        const char *q = p + 1;
+        bool eneg = false;
+        if(q < end && (*q == '-' || *q == '+')) eneg = (*q++ == '-');
+        uint64_t e;
+        q = scan_uint(q, end, e);
+        if(q) {
+            double base = eneg ? 0.1 : 10.0;
+            while(e--) v *= base;
+            p = q;
+        }
+    }
+    val = (real_t)(neg ? -v : v);
+    return p;
+}
+
+/** `id` as a vertex id, an id wider than `vid_t` is fatal instead of wrapping around */
+inline vid_t to_vid(uint64_t id) {
+    if(id > std::numeric_limits<vid_t>::max()) {
+        logstream(LOG_FATAL) << "vertex id " << id << " exceeds the largest vertex id " << std::numeric_limits<vid_t>::max() << std::endl;
+    }
+    return (vid_t)id;
+}
+
+/** parse the lines in [p, end), the self loops are dropped like the line based converter did */
+void parse_chunk(const char *p, const char *end, bool weighted, std::vector<edge_t> &edges) {
+    edges.clear();
+    while(p < end) {
+        if(*p == '#' || *p == '%') {
+            p = skip_line(p, end);
+            continue;
+        }
+        p = skip_separators(p, end);
+        if(p == end) break;
+        if(*p == '\n') {
+            p++;
+            continue;
+        }
+
+        uint64_t from, to;
+        edge_t e;
+        e.weight = 0.0;
+        const char *q = scan_uint(p, end, from);
+        if(q) q = scan_uint(skip_separators(q, end), end, to);
+        if(q && weighted) q = scan_float(skip_separators(q, end), end, e.weight);
+        if(q == NULL) {
+            logstream(LOG_ERROR) << "Input file is not the right format. Expected <from> <to>" << (weighted ? " <weight>" : "") << std::endl;
+            assert(false);
+        }
+        p = skip_line(q, end);
+        if(from == to) continue;
+        e.from = to_vid(from);
+        e.to   = to_vid(to);
+        edges.push_back(e);
+    }
+}
+
+/** a read only mapping of an input file */
+struct input_map {
+    int fd;
+    const char *data;
+    size_t len;
+
+    input_map(const std::string& filename) {
+        fd = open(filename.c_str(), O_RDONLY);
+        if(fd < 0) {
+            logstream(LOG_ERROR) << "can not open input " << filename << std::endl;
+            assert(false);
+        }
+        len = lseek(fd, 0, SEEK_END);
+        data = NULL;
+        if(len > 0) {
+            data = (const char*)mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+            assert(data != MAP_FAILED);
+            madvise((void*)data, len, MADV_SEQUENTIAL);
+        }
+    }
+
+    ~input_map() {
+        if(data) munmap((void*)data, len);
+        close(fd);
+    }
+};
+
+/** line aligned chunk boundaries of [begin, len) */
+std::vector<size_t> split_lines(const char *data, size_t begin, size_t len) {
+    size_t chunk_size = PARSE_CHUNK_SIZE;
+    std::vector<size_t> bounds(1, begin);
+    while(bounds.back() < len) {
+        size_t next = bounds.back() + chunk_size;
+        if(next >= len) next = len;
+        else next = skip_line(data + next, data + len) - data;
+        bounds.push_back(next);
+    }
+    return bounds;
+}
+
+/**
+ * parse the chunks given by `bounds` on all cores with `parse(p, end, records)`, one window of nthreads
+ * chunks at a time, `callback(record)` is called for every record in file order by the feeder thread.
+ */
+template<typename record_t, typename parser_t, typename callback_t>
+void parse_parallel(const char *data, const std::vector<size_t>& bounds, parser_t parse, callback_t callback) {
+    size_t nchunks = bounds.size() - 1;
+    int nthreads = omp_get_max_threads();
+    std::vector<std::vector<record_t>> parsed(nthreads), feeding(nthreads);
+    std::thread feeder;
+    for(size_t w = 0; w < nchunks; w += nthreads) {
+        size_t n = min_value(nchunks - w, (size_t)nthreads);
+        #pragma omp parallel for schedule(dynamic, 1)
+        for(size_t c = 0; c < n; c++) {
+            parse(data + bounds[w + c], data + bounds[w + c + 1], parsed[c]);
+        }
+
+        /* the previous window must be fed before its buffers are reused */
+        if(feeder.joinable()) feeder.join();
+        std::swap(parsed, feeding);
+        feeder = std::thread([&feeding, n, &callback]() {
+            for(size_t c = 0; c < n; c++) {
+                for(const auto & r : feeding[c]) callback(r);
+            }
+        });
+    }
+    if(feeder.joinable()) feeder.join();
+}
+
+/** parse the edge list `filename` on all cores, `callback(edge)` is called for every edge in file order */
+template<typename callback_t>
+void parse_edges(const std::string& filename, bool weighted, callback_t callback) {
+    input_map input(filename);
+    if(input.len == 0) return;
+
+    std::vector<size_t> bounds = split_lines(input.data, 0, input.len);
+    logstream(LOG_INFO) << "parse " << filename << " : " << input.len << " bytes, " << bounds.size() - 1 << " chunks, " << omp_get_max_threads() << " threads" << std::endl;
+    parse_parallel<edge_t>(input.data, bounds, [weighted](const char *p, const char *end, std::vector<edge_t>& edges) {
+        parse_chunk(p, end, weighted, edges);
+    }, callback);
+}
+
+#endif
@@ -0,0 +1,150 @@
+#ifndef _GRAPH_PARTITION_H_
+#define _GRAPH_PARTITION_H_
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include "api/types.hpp"
+#include "logger/logger.hpp"
+#include "util/util.hpp"
+#include "reorder.hpp"
+
+/**
+ * This file defines the block partitioners other than the edge count split of `split_blocks`, and the
+ * writer of the block files they share. A block is still a vertex range, so the engine reads the
+ * `.vert.blocks` and `.edge.blocks` files the same way whichever partitioner produced them.
+ */
+
+/** write the split points and the graph meta data, `vblocks` ends at the number of vertices */
+void write_graph_blocks(const std::string& filename, size_t block_size, const std::vector<vid_t>& vblocks, const std::vector<eid_t>& eblocks) {
+    /** write the vertex split points into vertex block file */
+    std::string vblockfile = get_vert_blocks_name(filename, block_size);
+    auto vblf = std::fstream(vblockfile.c_str(), std::ios::out | std::ios::binary);
+    vblf.write((char*)&vblocks[0], vblocks.size() * sizeof(vid_t));
+    vblf.close();
+
+    /** write the edge split points into edge block file */
+    std::string eblockfile = get_edge_blocks_name(filename, block_size);
+    auto eblf = std::fstream(eblockfile.c_str(), std::ios::out | std::ios::binary);
+    eblf.write((char*)&eblocks[0], eblocks.size() * sizeof(eid_t));
+    eblf.close();
+
+    /** write the graph meta data into meta file */
+    std::string metafile = get_meta_name(filename);
+    auto metastream = std::fstream(metafile.c_str(), std::ios::out | std::ios::binary);
+    metastream.write((char*)&vblocks.back(), sizeof(vid_t));
+    metastream.write((char*)&eblocks.back(), sizeof(eid_t));
+    metastream.close();
+}
+
+/**
+ * split the vertices into blocks of at most `block_size` bytes of csr, placing each cut where the least
+ * transition probability crosses it. From the block start, the window up to the edge budget is scanned,
+ * and each edge `v -> u` adds `1 / deg(v)` to every cut position in `(min(u, v), max(u, v)]` with a
+ * difference array, edges leaving the window count for all cuts after `v`. The cut is chosen among the
+ * positions after `fill * block_size` bytes of csr, so blocks do not degenerate.
+ */
+size_t split_blocks_locality(const std::string& filename, int fnum, size_t block_size, double fill) {
+    csr_map g(filename, fnum);
+    eid_t max_nedges = (eid_t)block_size / sizeof(vid_t);
+    eid_t min_nedges = (eid_t)(max_nedges * fill);
+    vid_t nvertices = g.nvertices;
+    logstream(LOG_INFO) << "start locality split blocks, blocksize = " << block_size / (1024 * 1024) << "MB, max_nedges = " << max_nedges << ", min_nedges = " << min_nedges << std::endl;
+
+    std::vector<vid_t> vblocks(1, 0);
+    std::vector<eid_t> eblocks(1, 0);
+    std::vector<double> cross;
+    vid_t start = 0;
+    while(start < nvertices) {
+        /* the window [start, end) fills the edge budget */
+        vid_t end = start + 1;
+        while(end < nvertices && g.beg_pos[end + 1] - g.beg_pos[start] <= max_nedges) end++;
+
+        vid_t cut = end;
+        double best = 0.0;
+        if(end < nvertices) {
+            /* cross[t - start] is the probability crossing a cut before vertex t */
+            cross.assign(end - start + 2, 0.0);
+            for(vid_t v = start; v < end; v++) {
+                vid_t deg = g.beg_pos[v + 1] - g.beg_pos[v];
+                if(deg == 0) continue;
+                double w = 1.0 / deg;
+                for(eid_t e = g.beg_pos[v]; e < g.beg_pos[v + 1]; e++) {
+                    vid_t u = g.adj[e];
+                    if(u < start) continue;
+                    vid_t lo = min_value(u, v), hi = min_value(max_value(u, v), end);
+                    cross[lo + 1 - start] += w;
+                    cross[hi + 1 - start] -= w;
+                }
+            }
+            best = -1.0;
+            double sum = 0.0;
+            for(vid_t t = start + 1; t <= end; t++) {
+                sum += cross[t - start];
+                eid_t nedges = g.beg_pos[t] - g.beg_pos[start];
+                if(nedges < min_nedges) continue;
+                double score = sum / max_value(nedges, (eid_t)1);
+                if(best < 0.0 || score <= best) {
+                    best = score;
+                    cut = t;
+                }
+            }
+        }
+        logstream(LOG_INFO) << "Block " << vblocks.size() - 1 << " : [ " << start << ", " << cut << " ), csr position : [ " << g.beg_pos[start] << ", " << g.beg_pos[cut] << " ), cut weight : " << best << std::endl;
+        vblocks.push_back(cut);
+        eblocks.push_back(g.beg_pos[cut]);
+        start = cut;
+    }
+    logstream(LOG_INFO) << "Total blocks num : " << vblocks.size() - 1 << std::endl;
+
+    write_graph_blocks(filename, block_size, vblocks, eblocks);
+    return vblocks.size() - 1;
+}
+
+/**
+ * write the hub block of the `nhubs` vertices of the highest in-degree: `.hub` the sorted ids, `.hbeg`
+ * and `.hcsr` their adjacency in csr form. The engine pins it in memory, so walks arriving at a hub
+ * keep stepping without moving to the hub's block.
+ */
+void write_hub_block(const std::string& filename, int fnum, vid_t nhubs) {
+    csr_map g(filename, fnum);
+    nhubs = min_value(nhubs, g.nvertices);
+    std::vector<eid_t> indegree(g.nvertices, 0);
+    for(eid_t e = 0; e < g.beg_pos[g.nvertices]; e++) indegree[g.adj[e]]++;
+
+    std::vector<vid_t> ids(g.nvertices);
+    for(vid_t v = 0; v < g.nvertices; v++) ids[v] = v;
+    std::partial_sort(ids.begin(), ids.begin() + nhubs, ids.end(), [&indegree](vid_t a, vid_t b) {
+        return indegree[a] > indegree[b] || (indegree[a] == indegree[b] && a < b);
+    });
+    ids.resize(nhubs);
+    std::sort(ids.begin(), ids.end());
+
+    std::vector<eid_t> beg_pos(1, 0);
+    std::vector<vid_t> csr;
+    eid_t hits = 0;
+    for(vid_t h : ids) {
+        csr.insert(csr.end(), g.adj + g.beg_pos[h], g.adj + g.beg_pos[h + 1]);
+        beg_pos.push_back(csr.size());
+        hits += indegree[h];
+    }
+
+    auto write = [](const std::string& name, const char *data, size_t bytes) {
+        auto out = std::fstream(name.c_str(), std::ios::out | std::ios::binary);
+        out.write(data, bytes);
+        out.close();
+    };
+    write(get_hub_name(filename), (const char*)ids.data(), ids.size() * sizeof(vid_t));
+    write(get_hub_beg_pos_name(filename), (const char*)beg_pos.data(), beg_pos.size() * sizeof(eid_t));
+    write(get_hub_csr_name(filename), (const char*)csr.data(), csr.size() * sizeof(vid_t));
+    logstream(LOG_INFO) << "hub block : " << nhubs << " hubs, " << csr.size() << " edges, receive " << hits << " of " << g.beg_pos[g.nvertices] << " edges" << std::endl;
+}
+
+void remove_hub_block(const std::string& filename) {
+    test_delete(get_hub_name(filename));
+    test_delete(get_hub_beg_pos_name(filename));
+    test_delete(get_hub_csr_name(filename));
+}
+
+#endif
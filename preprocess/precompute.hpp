@@ -65,6 +65,10 @@ void construct_alias_table(const pre_block_t& block, pre_alias_table& table) {
         }
         real_t *adj_prob  = table.prob + block.beg_pos[vertex];
         vid_t  *adj_alias = table.alias + block.beg_pos[vertex];
+        if(sum <= 0.0) {
+            for(vid_t off = 0; off < deg; off++) adj_prob[off] = 1.0, adj_alias[off] = off;
+            continue;
+        }
         while(!small.empty() && !large.empty()) {
             vid_t s = small.front(), l = large.front();
             small.pop(); large.pop();
@@ -88,6 +92,12 @@ void construct_alias_table(const pre_block_t& block, pre_alias_table& table) {
             adj_prob[s] = sum;
             adj_alias[s] = deg;
         }
+
+        /* keep the acceptance probability in [0, 1], the sampler compares it with a uniform float */
+        for(vid_t off = 0; off < deg; off++) {
+            adj_prob[off] /= sum;
+            if(adj_prob[off] >= 1.0) adj_alias[off] = off;
+        }
     }
 }
 
@@ -112,8 +122,8 @@ void construct_accumulate(const pre_block_t& block, real_t* acw) {
 void second_order_precompute(const std::string& filename, int fnum, size_t blocksize) {
     std::string vert_block_name = get_vert_blocks_name(filename, blocksize);
     std::string edge_block_name = get_edge_blocks_name(filename, blocksize);
-    std::string degree_name = get_degree_name(filename, fnum);
-    std::string csr_name = get_csr_name(filename, fnum);
+    std::string beg_pos_name = get_beg_pos_name(filename, fnum);
+    std::string weights_name = get_weights_name(filename, fnum);
     std::string prob_name = get_prob_name(filename, fnum);
     std::string alias_name = get_alias_name(filename, fnum);
     std::string acc_name = get_accumulate_name(filename, fnum);
@@ -121,9 +131,12 @@ void second_order_precompute(const std::string& filename, int fnum, size_t block
     std::vector<vid_t> vblocks = load_graph_blocks<vid_t>(vert_block_name);
     std::vector<eid_t> eblocks = load_graph_blocks<eid_t>(edge_block_name);
 
-    int vertdesc = open(degree_name.c_str(), O_RDONLY);
-    int edgedesc = open(csr_name.c_str(), O_RDONLY);
-    assert(vertdesc > 0 && edgedesc > 0);
+    int vertdesc = open(beg_pos_name.c_str(), O_RDONLY);
+    int whtdesc  = open(weights_name.c_str(), O_RDONLY);
+    assert(vertdesc > 0 && whtdesc > 0);
+    test_delete(prob_name);
+    test_delete(alias_name);
+    test_delete(acc_name);
 
     bid_t nblocks = vblocks.size() - 1;
     logstream(LOG_INFO) << "load vblocks and eblocks successfully, block count : " << nblocks << std::endl;
@@ -138,12 +151,16 @@ void second_order_precompute(const std::string& filename, int fnum, size_t block
         block.start_edge = eblocks[blk];
 
         block.beg_pos = (eid_t*)realloc(block.beg_pos, (block.nverts + 1) * sizeof(eid_t));
-        block.csr     = (vid_t*)realloc(block.csr, block.nedges * sizeof(vid_t));
-        block.weights = (real_t*)realloc(block.weights, block.nedges * sizeof(real_t));
-        table.prob    = (real_t*)realloc(table.prob, block.nedges * sizeof(real_t));
-        table.alias   = (vid_t*)realloc(table.alias, block.nedges * sizeof(real_t));
-        acw           = (real_t*)realloc(acw, block.nedges * sizeof(real_t));
-        
+        block.weights = (real_t*)realloc(block.weights, max_value(block.nedges, 1) * sizeof(real_t));
+        table.prob    = (real_t*)realloc(table.prob, max_value(block.nedges, 1) * sizeof(real_t));
+        table.alias   = (vid_t*)realloc(table.alias, max_value(block.nedges, 1) * sizeof(vid_t));
+        acw           = (real_t*)realloc(acw, max_value(block.nedges, 1) * sizeof(real_t));
+
+        /* the tables are indexed by the edge offset inside the block */
+        load_block_range(vertdesc, block.beg_pos, block.nverts + 1, block.start_vert * sizeof(eid_t));
+        for(vid_t v = 0; v <= block.nverts; v++) block.beg_pos[v] -= block.start_edge;
+        load_block_range(whtdesc, block.weights, block.nedges, block.start_edge * sizeof(real_t));
+
         construct_alias_table(block, table);
         appendfile(prob_name, table.prob, block.nedges);
         appendfile(alias_name, table.alias, block.nedges);
@@ -155,7 +172,7 @@ void second_order_precompute(const std::string& filename, int fnum, size_t block
 
     if(acw) free(acw);
     close(vertdesc);
-    close(edgedesc);
+    close(whtdesc);
 }
 
 #endif
\ No newline at end of file
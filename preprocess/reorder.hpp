@@ -0,0 +1,122 @@
+#ifndef _GRAPH_REORDER_H_
+#define _GRAPH_REORDER_H_
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <fstream>
+#include <sys/mman.h>
+#include "api/types.hpp"
+#include "logger/logger.hpp"
+#include "util/util.hpp"
+#include "parser.hpp"
+
+/**
+ * This file defines the vertex reordering pass. A walk leaves its block as soon as it steps to a vertex
+ * outside `[start_vert, end_vert)`, so vertices that are visited one after another should get close ids.
+ * An order is computed from the converted csr, `order[new id] = old id`, it is persisted as `.perm`,
+ * and the edges are relabeled and converted again.
+ *
+ * `degree` : descending total degree, the hubs and their frequent visits share the first blocks
+ * `bfs`    : breadth first order from the unvisited vertex of the highest degree, neighbors get near ids
+ */
+
+/** the csr of file `fnum` mapped read only */
+struct csr_map {
+    input_map beg, csr;
+    const eid_t *beg_pos;
+    const vid_t *adj;
+    vid_t nvertices;
+
+    csr_map(const std::string& base, int fnum = 0) : beg(get_beg_pos_name(base, fnum)), csr(get_csr_name(base, fnum)) {
+        beg_pos   = (const eid_t*)beg.data;
+        adj       = (const vid_t*)csr.data;
+        nvertices = beg.len / sizeof(eid_t) - 1;
+        madvise((void*)beg.data, beg.len, MADV_NORMAL);
+        if(csr.data) madvise((void*)csr.data, csr.len, MADV_NORMAL);
+    }
+};
+
+/** out degree plus in degree of every vertex */
+std::vector<eid_t> total_degree(const csr_map& g) {
+    std::vector<eid_t> degree(g.nvertices);
+    for(vid_t v = 0; v < g.nvertices; v++) degree[v] = g.beg_pos[v + 1] - g.beg_pos[v];
+    for(eid_t e = 0; e < g.beg_pos[g.nvertices]; e++) degree[g.adj[e]]++;
+    return degree;
+}
+
+std::vector<vid_t> degree_order(const csr_map& g) {
+    std::vector<eid_t> degree = total_degree(g);
+    std::vector<vid_t> order(g.nvertices);
+    for(vid_t v = 0; v < g.nvertices; v++) order[v] = v;
+    std::stable_sort(order.begin(), order.end(), [&degree](vid_t a, vid_t b) { return degree[a] > degree[b]; });
+    return order;
+}
+
+std::vector<vid_t> bfs_order(const csr_map& g) {
+    std::vector<vid_t> roots = degree_order(g);
+    std::vector<bool> visited(g.nvertices, false);
+    std::vector<vid_t> order;
+    order.reserve(g.nvertices);
+    for(vid_t r : roots) {
+        if(visited[r]) continue;
+        size_t head = order.size();
+        visited[r] = true;
+        order.push_back(r);
+        while(head < order.size()) {
+            vid_t u = order[head++];
+            for(eid_t e = g.beg_pos[u]; e < g.beg_pos[u + 1]; e++) {
+                vid_t v = g.adj[e];
+                if(!visited[v]) {
+                    visited[v] = true;
+                    order.push_back(v);
+                }
+            }
+        }
+    }
+    return order;
+}
+
+/** compute the order of the graph `base` with `method` and write it to `.perm` */
+std::vector<vid_t> compute_order(const std::string& base, const std::string& method) {
+    csr_map g(base);
+    std::vector<vid_t> order;
+    if(method == "degree") order = degree_order(g);
+    else if(method == "bfs") order = bfs_order(g);
+    else {
+        logstream(LOG_ERROR) << "unknown reorder method " << method << ", expected degree or bfs" << std::endl;
+        assert(false);
+    }
+    assert(order.size() == g.nvertices);
+
+    std::string perm_name = get_perm_name(base);
+    auto perm = std::fstream(perm_name.c_str(), std::ios::out | std::ios::binary);
+    perm.write((char*)&order[0], order.size() * sizeof(vid_t));
+    perm.close();
+    logstream(LOG_INFO) << "reorder " << g.nvertices << " vertices by " << method << ", permutation : " << perm_name << std::endl;
+    return order;
+}
+
+/** call `callback(edge)` for every edge of the csr `base` with the ids mapped by `order` */
+template<typename callback_t>
+void relabel_edges(const std::string& base, const std::vector<vid_t>& order, bool weighted, callback_t callback) {
+    csr_map g(base);
+    std::vector<vid_t> rank(g.nvertices);
+    for(vid_t v = 0; v < g.nvertices; v++) rank[order[v]] = v;
+
+    input_map *wht = weighted ? new input_map(get_weights_name(base, 0)) : NULL;
+    const real_t *weights = weighted ? (const real_t*)wht->data : NULL;
+    edge_t edge;
+    edge.weight = 0.0;
+    for(vid_t u = 0; u < g.nvertices; u++) {
+        edge.from = rank[u];
+        for(eid_t e = g.beg_pos[u]; e < g.beg_pos[u + 1]; e++) {
+            edge.to = rank[g.adj[e]];
+            if(weighted) edge.weight = weights[e];
+            callback(edge);
+        }
+    }
+    if(wht) delete wht;
+}
+
+#endif
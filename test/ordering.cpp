@@ -0,0 +1,71 @@
+#include <omp.h>
+#include <string>
+#include <vector>
+#include "api/types.hpp"
+#include "engine/walk.hpp"
+#include "logger/logger.hpp"
+#include "util/timer.hpp"
+#include "util/random.hpp"
+#include "util/cmdopts.hpp"
+
+/**
+ * The walk ordering benchmark: for blocks of growing size, random walks are placed uniformly on the
+ * block's vertices and each takes one step, first in arrival order and then after `sort_walks_by_pos`.
+ * Only the first step of a walk benefits from the order, the later in-block hops are random anyway,
+ * so the gain is the arrival time minus the sorted time, against the cost of the sort.
+ *
+ * ./bin/test/ordering [nwalks=4194304] [maxsize=256] [seed=1]
+ * `maxsize` is the largest block in MB, build with `make EXTRA_FLAGS="-O2"` for meaningful timings.
+ */
+
+/** take one uniform step of every walk, return a checksum so the loop is not dropped */
+eid_t step_walks(const walk_t *walks, size_t n, const eid_t *beg_pos, const vid_t *csr, uint64_t seed) {
+    eid_t check = 0;
+    #pragma omp parallel for schedule(static) reduction(+:check)
+    for(size_t i = 0; i < n; i++) {
+        rand_t rng(seed, walks[i].id, walks[i].hop);
+        vid_t v = walks[i].pos;
+        eid_t head = beg_pos[v], deg = beg_pos[v + 1] - head;
+        check += csr[head + rng.gen(deg)];
+    }
+    return check;
+}
+
+int main(int argc, char* argv[]) {
+    set_argc(argc, argv);
+    size_t nwalks  = get_option_int("nwalks", 4 * 1024 * 1024);
+    size_t maxsize = get_option_int("maxsize", 256);
+    uint64_t seed  = get_option_int("seed", 1);
+    tid_t nthreads = omp_get_max_threads();
+
+    rand_t rng(seed, 0, 0);
+    std::vector<walk_t> walks(nwalks);
+    for(size_t mb = 4; mb <= maxsize; mb *= 4) {
+        /* a block of `mb` MB of csr with degrees 1..32, the layout of a cached block */
+        std::vector<eid_t> beg_pos(1, 0);
+        while(beg_pos.back() * sizeof(vid_t) < mb * 1024 * 1024) beg_pos.push_back(beg_pos.back() + rng.gen(32) + 1);
+        vid_t nverts = beg_pos.size() - 1;
+        std::vector<vid_t> csr(beg_pos.back());
+        for(eid_t e = 0; e < csr.size(); e++) csr[e] = rng.gen(nverts);
+        for(size_t i = 0; i < nwalks; i++) walks[i] = walk_encode(10, rng.gen(nverts), 0, i);
+
+        graph_timer timer;
+        timer.start_time();
+        eid_t arrival = step_walks(walks.data(), nwalks, beg_pos.data(), csr.data(), seed);
+        double arrival_time = timer.runtime();
+
+        timer.start_time();
+        sort_walks_by_pos(walks.data(), nwalks, 0, nverts, nthreads);
+        double sort_time = timer.runtime();
+
+        timer.start_time();
+        eid_t sorted = step_walks(walks.data(), nwalks, beg_pos.data(), csr.data(), seed);
+        double sorted_time = timer.runtime();
+        assert(arrival == sorted);
+
+        logstream(LOG_INFO) << "block " << mb << "MB : " << nverts << " vertices, " << nwalks << " walks, ns per walk, arrival : " << arrival_time * 1e9 / nwalks
+                            << ", sort : " << sort_time * 1e9 / nwalks << ", sorted : " << sorted_time * 1e9 / nwalks
+                            << ", gain : " << (arrival_time - sorted_time - sort_time) * 1e9 / nwalks << std::endl;
+    }
+    return 0;
+}
@@ -1,12 +1,33 @@
 #include "preprocess/graph_converter.hpp"
+#include "preprocess/compress.hpp"
 #include "engine/config.hpp"
+#include "util/cmdopts.hpp"
+#include "util/memory.hpp"
 
 int main(int argc, char* argv[]) {
     assert(argc >= 2);
+    set_argc(argc, argv);
     logstream(LOG_INFO) << "app : " << argv[0] << ", dataset : " << argv[1] << std::endl;
     std::string input = argv[1];
-    graph_converter converter(remove_extension(input));
-    convert(input, converter);
+    bool weighted = get_option_int("weighted", 0) != 0;
+    size_t block_size = BLOCK_SIZE;
+    block_size = (size_t)get_option_int("blocksize", block_size >> 20) << 20;
+    size_t vert_size, edge_size, sort_memory;
+    plan_convert_memory(memory_budget(get_option_int("memory", 0)), weighted, vert_size, edge_size, sort_memory);
+    graph_converter converter(remove_extension(input), vert_size, edge_size, block_size, weighted);
+    convert_options opts;
+    opts.format = get_option_string("format", "text");
+    opts.reorder = get_option_string("reorder", "none");
+    opts.partition = get_option_string("partition", "edges");
+    opts.partition_fill = get_option_float("partition_fill", 0.5);
+    opts.hubs = get_option_int("hubs", 0);
+    opts.sort  = get_option_int("sort", 0);
+    opts.dedup = get_option_int("dedup", 0);
+    opts.sort_memory = (size_t)get_option_int("sort_memory", sort_memory >> 20) << 20;
+    convert(input, converter, block_size, opts);
+    if(get_option_int("compress", 0)) {
+        compress_blocks(converter.get_output_filename(), 0, block_size);
+    }
     logstream(LOG_INFO) << "  ================= FINISHED ======================  " << std::endl;
     return 0;
 }
\ No newline at end of file
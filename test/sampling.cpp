@@ -0,0 +1,118 @@
+#include <cmath>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "api/types.hpp"
+#include "engine/context.hpp"
+#include "preprocess/precompute.hpp"
+#include "logger/logger.hpp"
+#include "util/timer.hpp"
+#include "util/random.hpp"
+#include "util/cmdopts.hpp"
+
+/**
+ * The weighted sampling benchmark: a block of random weights is built for a degree distribution, and
+ * the same draws are timed with the alias tables, the ITS kernel and `std::upper_bound` over `.acc`.
+ * The ITS kernel is checked against `std::upper_bound` on every draw.
+ *
+ * ./bin/test/sampling [nedges=16777216] [samples=16777216] [seed=1]
+ * build with `make EXTRA_FLAGS="-O2 -mavx2"` for meaningful timings and the vectorized search of the short lists.
+ */
+
+/** a block of `nedges` edges whose vertex degrees are given by `degree(rng)` */
+template<typename degree_t>
+void build_block(eid_t nedges, degree_t degree, rand_t &rng, pre_block_t &block) {
+    std::vector<eid_t> beg_pos(1, 0);
+    while(beg_pos.back() < nedges) beg_pos.push_back(beg_pos.back() + degree(rng));
+    block.start_vert = block.start_edge = 0;
+    block.nverts  = beg_pos.size() - 1;
+    block.nedges  = beg_pos.back();
+    block.beg_pos = (eid_t*)realloc(block.beg_pos, beg_pos.size() * sizeof(eid_t));
+    block.weights = (real_t*)realloc(block.weights, block.nedges * sizeof(real_t));
+    std::copy(beg_pos.begin(), beg_pos.end(), block.beg_pos);
+    for(eid_t e = 0; e < block.nedges; e++) block.weights[e] = 1.0f - rng.gen_float();
+}
+
+void bench(const std::string& name, const pre_block_t& block, size_t samples, uint64_t seed) {
+    pre_alias_table table;
+    table.prob  = (real_t*)malloc(block.nedges * sizeof(real_t));
+    table.alias = (vid_t*)malloc(block.nedges * sizeof(vid_t));
+    real_t *acc = (real_t*)malloc(block.nedges * sizeof(real_t));
+    construct_alias_table(block, table);
+    construct_accumulate(block, acc);
+
+    /* the vertices are drawn ahead, so the timed loops only differ in the search */
+    rand_t rng(seed, 0, 0);
+    std::vector<vid_t> verts(samples);
+    for(size_t i = 0; i < samples; i++) verts[i] = rng.gen(block.nverts);
+
+    graph_timer timer;
+    eid_t check = 0;
+    rng = rand_t(seed, 1, 0);
+    timer.start_time();
+    for(size_t i = 0; i < samples; i++) {
+        vid_t v = verts[i];
+        eid_t head = block.beg_pos[v];
+        check += alias_sample(table.prob + head, table.alias + head, block.beg_pos[v + 1] - head, &rng);
+    }
+    double alias_time = timer.runtime();
+
+    rng = rand_t(seed, 2, 0);
+    timer.start_time();
+    for(size_t i = 0; i < samples; i++) {
+        vid_t v = verts[i];
+        eid_t head = block.beg_pos[v];
+        check += its_sample(acc + head, block.beg_pos[v + 1] - head, &rng);
+    }
+    double its_time = timer.runtime();
+
+    rng = rand_t(seed, 2, 0);
+    timer.start_time();
+    for(size_t i = 0; i < samples; i++) {
+        vid_t v = verts[i];
+        eid_t head = block.beg_pos[v], deg = block.beg_pos[v + 1] - head;
+        real_t u = rng.gen_float() * acc[head + deg - 1];
+        check += std::min((eid_t)(std::upper_bound(acc + head, acc + head + deg, u) - (acc + head)), deg - 1);
+    }
+    double search_time = timer.runtime();
+
+    /* the same stream drives both ITS loops, so every draw must agree */
+    rng = rand_t(seed, 3, 0);
+    for(size_t i = 0; i < samples; i++) {
+        vid_t v = verts[i];
+        eid_t head = block.beg_pos[v], deg = block.beg_pos[v + 1] - head;
+        real_t u = rng.gen_float() * acc[head + deg - 1];
+        eid_t expect = std::upper_bound(acc + head, acc + head + deg, u) - (acc + head);
+        assert(its_search(acc + head, deg, u) == expect);
+    }
+    free(acc);
+
+    logstream(LOG_INFO) << name << " : " << block.nverts << " vertices, " << block.nedges << " edges, ns per sample, alias : " << alias_time * 1e9 / samples
+                        << ", its : " << its_time * 1e9 / samples << ", upper_bound : " << search_time * 1e9 / samples << " (" << check % 2 << ")" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    set_argc(argc, argv);
+    eid_t nedges   = get_option_int("nedges", 16 * 1024 * 1024);
+    size_t samples = get_option_int("samples", 16 * 1024 * 1024);
+    uint64_t seed  = get_option_int("seed", 1);
+#ifdef __AVX2__
+    logstream(LOG_INFO) << "ITS kernel : AVX2 up to degree " << ITS_LINEAR_DEGREE << ", branchless binary search above" << std::endl;
+#else
+    logstream(LOG_INFO) << "ITS kernel : branchless binary search" << std::endl;
+#endif
+
+    rand_t rng(seed, 0, 0);
+    pre_block_t block;
+    eid_t fixed[] = { 4, 16, 64, 1024 };
+    for(eid_t deg : fixed) {
+        build_block(nedges, [deg](rand_t &) { return deg; }, rng, block);
+        bench("degree " + std::to_string(deg), block, samples, seed);
+    }
+    build_block(nedges, [](rand_t &r) { return (eid_t)r.gen(64) + 1; }, rng, block);
+    bench("uniform degree 1..64", block, samples, seed);
+    /* Pareto degrees of exponent 1.5 capped at 64K, most vertices are short lists and a few are hubs */
+    build_block(nedges, [](rand_t &r) { return (eid_t)std::min(std::pow(1.0 - r.gen_float(), -1.0 / 1.5), 65536.0); }, rng, block);
+    bench("power law", block, samples, seed);
+    return 0;
+}
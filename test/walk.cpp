@@ -1,4 +1,6 @@
 #include <omp.h>
+#include <ctime>
+#include <memory>
 #include "api/constants.hpp"
 #include "engine/config.hpp"
 #include "engine/cache.hpp"
@@ -8,13 +10,20 @@
 #include "logger/logger.hpp"
 #include "util/io.hpp"
 #include "util/util.hpp"
+#include "util/cmdopts.hpp"
+#include "util/memory.hpp"
 #include "apps/randomwalk.hpp"
+#include "apps/node2vec.hpp"
+#include "apps/ppr.hpp"
 
 int main(int argc, char* argv[]) {
     assert(argc >= 2);
+    set_argc(argc, argv);
     logstream(LOG_INFO) << "app : " << argv[0] << ", dataset : " << argv[1] << std::endl;
     std::string input = remove_extension(argv[1]);
-    std::string base_name = randgraph_output_filename(get_path_name(input), get_file_name(input), BLOCK_SIZE);
+    size_t block_size = BLOCK_SIZE;
+    block_size = (size_t)get_option_int("blocksize", block_size >> 20) << 20;
+    std::string base_name = randgraph_output_filename(get_path_name(input), get_file_name(input), block_size);
 
     /* graph meta info */
     vid_t nvertices;
@@ -24,24 +33,53 @@ int main(int argc, char* argv[]) {
     graph_config conf = {
         base_name,
         0,
-        BLOCK_SIZE,
+        block_size,
         (tid_t)omp_get_max_threads(),
         nvertices,
-        nedges
+        nedges,
+        (uint64_t)get_option_int("seed", time(NULL)),
+        (unsigned)get_option_int("io_depth", 32),
+        get_option_int("weighted", 0) != 0,
+        get_option_string("sampler", "alias") == "its",
+        get_option_int("pipeline", 0) != 0,
+        get_option_int("multiblock", 0) != 0,
+        get_option_string("exec", "static") == "steal",
+        get_option_string("order", "arrival") == "pos",
+        get_option_string("spill", "raw") == "packed",
+        memory_budget(get_option_int("memory", 0))
     };
 
     graph_block blocks(&conf);
-    graph_driver driver;
-    walk_schedule_t block_scheduler(&conf, 0.2);
-    graph_walk walk_mangager(conf, blocks, driver);
-    graph_cache cache(blocks.nblocks, conf.blocksize);
+    plan_memory(conf, blocks.nblocks, blocks.hubs.memory_size());
+    std::unique_ptr<graph_driver> driver(create_driver(get_option_string("driver", "pread"), &conf));
+    walk_schedule_t block_scheduler(&conf, 0.2, conf.prefetch_depth);
+    graph_walk walk_mangager(conf, blocks, *driver);
+    graph_cache cache(blocks.nblocks, block_memory_size(conf), blocks.hubs.memory_size(), conf.cache_memory);
     
-    randomwalk_t userprogram(10000, 25, 0.15);
-    graph_engine engine(cache, walk_mangager, driver, conf);
-    
-    engine.prologue(userprogram);
-    engine.run(userprogram, block_scheduler);
-    engine.epilogue(userprogram);
+    std::string app = get_option_string("app", "randomwalk");
+    std::unique_ptr<randomwalk_t> userprogram;
+    ppr_t *ppr = NULL;
+    if(app == "node2vec") userprogram.reset(new node2vec_t(10000, 25, get_option_float("p", 1.0), get_option_float("q", 1.0)));
+    else if(app == "ppr") {
+        ppr = new ppr_t(base_name, conf.nthreads, nvertices, get_option_int("firstsource", 0), get_option_int("nsources", 100),
+                        get_option_int("walkspersource", 1000), get_option_int("hops", 10), get_option_float("reset", 0.15));
+        userprogram.reset(ppr);
+    }
+    else userprogram.reset(new randomwalk_t(10000, 25, 0.15));
+    graph_engine engine(cache, walk_mangager, *driver, conf);
 
+    /* path=text or path=bin records the walks and writes them as a corpus after the run */
+    std::string path = get_option_string("path", "none");
+    std::unique_ptr<path_recorder> paths;
+    if(path != "none") {
+        paths.reset(new path_recorder(base_name, conf.nthreads));
+        walk_mangager.paths = paths.get();
+    }
+    
+    engine.prologue(*userprogram);
+    engine.run(*userprogram, block_scheduler);
+    engine.epilogue(*userprogram);
+    if(ppr) ppr->write_topk(base_name + ".ppr.txt", get_option_int("topk", 20), SORT_MEMORY);
+    if(paths) paths->stitch(base_name + (path == "text" ? ".corpus.txt" : ".corpus"), path == "text", SORT_MEMORY);
     return 0;
 }
\ No newline at end of file
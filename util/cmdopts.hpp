@@ -0,0 +1,50 @@
+#ifndef _GRAPH_CMDOPTS_H_
+#define _GRAPH_CMDOPTS_H_
+
+#include <string>
+#include <cstdlib>
+#include <cstring>
+
+/** cmdopts
+ *
+ * This file defines the command line options in the form `key=value`, e.g.
+ *   ./bin/test/walk dataset.txt seed=42 driver=mmap
+ * The positional arguments before the options are left to the application.
+ */
+
+static int cmd_argc = 0;
+static char **cmd_argv = NULL;
+
+inline void set_argc(int argc, char **argv) {
+    cmd_argc = argc;
+    cmd_argv = argv;
+}
+
+/** return true if `key` is given, and store its value */
+inline bool get_option(const std::string& key, std::string& value) {
+    std::string prefix = key + "=";
+    for(int i = 1; i < cmd_argc; i++) {
+        if(strncmp(cmd_argv[i], prefix.c_str(), prefix.size()) == 0) {
+            value = std::string(cmd_argv[i] + prefix.size());
+            return true;
+        }
+    }
+    return false;
+}
+
+inline std::string get_option_string(const std::string& key, const std::string& default_value) {
+    std::string value;
+    return get_option(key, value) ? value : default_value;
+}
+
+inline long long get_option_int(const std::string& key, long long default_value) {
+    std::string value;
+    return get_option(key, value) ? atoll(value.c_str()) : default_value;
+}
+
+inline float get_option_float(const std::string& key, float default_value) {
+    std::string value;
+    return get_option(key, value) ? (float)atof(value.c_str()) : default_value;
+}
+
+#endif
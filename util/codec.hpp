@@ -0,0 +1,157 @@
+#ifndef _GRAPH_CODEC_H_
+#define _GRAPH_CODEC_H_
+
+#include <stdint.h>
+#include <cstring>
+#include <cstddef>
+#include "api/types.hpp"
+
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
+
+/** codec
+ *
+ * This file defines the group varint codec used by the compressed csr blocks. It uses the stream
+ * layout: the 2-bit byte lengths of four values share one control byte, and all control bytes are
+ * stored before all data bytes, so a decoder can expand a whole group with a single shuffle.
+ *
+ * `[ control bytes : (n + 3) / 4 ][ data bytes : 1 ~ 4 per value ]`
+ *
+ * The decoder reads up to 16 bytes past the last group, so decode buffers need `GV_PADDING` bytes of slack.
+ * The csr neighbors are delta coded per vertex before encoding, see `delta_encode_block`.
+ *
+ * The fixed width bit packing `bp_encode` stores each value in the bits of the largest one, it is used
+ * for the walk fields which have no order, like the walk ids of a spilled batch.
+ */
+
+#define GV_PADDING 16
+
+inline size_t gv_control_bytes(size_t n) { return (n + 3) / 4; }
+
+inline size_t gv_max_bytes(size_t n) { return gv_control_bytes(n) + 4 * n; }
+
+inline unsigned gv_length(uint32_t v) {
+    return v < (1u << 8) ? 1 : v < (1u << 16) ? 2 : v < (1u << 24) ? 3 : 4;
+}
+
+/** encode `n` values into `out`, return the number of bytes written */
+inline size_t gv_encode(const uint32_t *in, size_t n, uint8_t *out) {
+    uint8_t *ctrl = out, *data = out + gv_control_bytes(n);
+    memset(ctrl, 0, gv_control_bytes(n));
+    for(size_t i = 0; i < n; i++) {
+        unsigned len = gv_length(in[i]);
+        ctrl[i >> 2] |= (uint8_t)((len - 1) << ((i & 3) * 2));
+        uint32_t v = in[i];
+        for(unsigned b = 0; b < len; b++, v >>= 8) *data++ = (uint8_t)v;
+    }
+    return data - out;
+}
+
+/** decode tables indexed by the control byte: the data bytes of the group, and its shuffle mask */
+struct gv_tables {
+    uint8_t length[256];
+#ifdef __SSSE3__
+    uint8_t shuffle[256][16];
+#endif
+    gv_tables() {
+        for(unsigned c = 0; c < 256; c++) {
+            unsigned pos = 0;
+            for(unsigned i = 0; i < 4; i++) {
+                unsigned len = ((c >> (i * 2)) & 3) + 1;
+#ifdef __SSSE3__
+                for(unsigned b = 0; b < 4; b++) shuffle[c][i * 4 + b] = b < len ? (uint8_t)(pos + b) : 0x80;
+#endif
+                pos += len;
+            }
+            length[c] = (uint8_t)pos;
+        }
+    }
+};
+
+inline const gv_tables& gv_get_tables() {
+    static gv_tables tables;
+    return tables;
+}
+
+/** decode `n` values from `in` */
+inline void gv_decode(const uint8_t *in, size_t n, uint32_t *out) {
+    const gv_tables &tables = gv_get_tables();
+    const uint8_t *ctrl = in, *data = in + gv_control_bytes(n);
+    size_t ngroups = n / 4;
+    for(size_t g = 0; g < ngroups; g++) {
+        uint8_t c = ctrl[g];
+#ifdef __SSSE3__
+        __m128i bytes = _mm_loadu_si128((const __m128i*)data);
+        __m128i mask  = _mm_loadu_si128((const __m128i*)tables.shuffle[c]);
+        _mm_storeu_si128((__m128i*)(out + g * 4), _mm_shuffle_epi8(bytes, mask));
+#else
+        const uint8_t *p = data;
+        for(unsigned i = 0; i < 4; i++) {
+            unsigned len = ((c >> (i * 2)) & 3) + 1;
+            uint32_t v = 0;
+            for(unsigned b = 0; b < len; b++) v |= (uint32_t)p[b] << (b * 8);
+            out[g * 4 + i] = v;
+            p += len;
+        }
+#endif
+        data += tables.length[c];
+    }
+    for(size_t i = ngroups * 4; i < n; i++) {
+        unsigned len = ((ctrl[i >> 2] >> ((i & 3) * 2)) & 3) + 1;
+        uint32_t v = 0;
+        for(unsigned b = 0; b < len; b++) v |= (uint32_t)data[b] << (b * 8);
+        out[i] = v;
+        data += len;
+    }
+}
+
+/** the bits needed for `v`, 0 for 0 */
+inline unsigned bit_width(uint32_t v) { return v ? 32 - __builtin_clz(v) : 0; }
+
+inline size_t bp_bytes(size_t n, unsigned width) { return (n * width + 7) / 8; }
+
+/** pack the low `width` bits of `n` values back to back into `out`, return the number of bytes written */
+inline size_t bp_encode(const uint32_t *in, size_t n, unsigned width, uint8_t *out) {
+    uint8_t *p = out;
+    uint64_t acc = 0;
+    unsigned filled = 0;
+    for(size_t i = 0; i < n; i++) {
+        acc |= (uint64_t)in[i] << filled;
+        filled += width;
+        for(; filled >= 8; filled -= 8, acc >>= 8) *p++ = (uint8_t)acc;
+    }
+    if(filled > 0) *p++ = (uint8_t)acc;
+    return p - out;
+}
+
+/** unpack `n` values of `width` bits from `in`, it reads exactly `bp_bytes(n, width)` bytes */
+inline void bp_decode(const uint8_t *in, size_t n, unsigned width, uint32_t *out) {
+    uint64_t acc = 0, mask = (1ULL << width) - 1;
+    unsigned filled = 0;
+    for(size_t i = 0; i < n; i++) {
+        for(; filled < width; filled += 8) acc |= (uint64_t)*in++ << filled;
+        out[i] = (uint32_t)(acc & mask);
+        acc >>= width;
+        filled -= width;
+    }
+}
+
+/** turn the neighbors of each vertex into gaps in place */
+void delta_encode_block(const vid_t *degree, vid_t nverts, vid_t *csr) {
+    eid_t pos = 0;
+    for(vid_t v = 0; v < nverts; v++) {
+        for(eid_t e = pos + degree[v]; e > pos + 1; e--) csr[e - 1] -= csr[e - 2];
+        pos += degree[v];
+    }
+}
+
+/** turn the gaps of each vertex back into neighbors in place */
+void delta_decode_block(const eid_t *beg_pos, vid_t nverts, eid_t start_edge, vid_t *csr) {
+    for(vid_t v = 0; v < nverts; v++) {
+        eid_t head = beg_pos[v] - start_edge, tail = beg_pos[v + 1] - start_edge;
+        for(eid_t e = head + 1; e < tail; e++) csr[e] += csr[e - 1];
+    }
+}
+
+#endif
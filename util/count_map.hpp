@@ -0,0 +1,58 @@
+#ifndef _GRAPH_COUNT_MAP_H_
+#define _GRAPH_COUNT_MAP_H_
+
+#include <vector>
+#include <stdint.h>
+#include "util/random.hpp"
+
+#define COUNT_EMPTY 0xffffffffffffffffULL     /* the key of an empty slot */
+
+/**
+ * A counting hash map of 64-bit keys, open addressing with linear probing over a power of two table.
+ * It holds at most `capacity` keys, at half load, and is meant to be drained when `full()`, so one
+ * thread's counts stay within a fixed memory. The used slots are listed, draining only visits them.
+ */
+class count_map {
+public:
+    std::vector<uint64_t> keys;
+    std::vector<uint32_t> counts;
+    std::vector<uint32_t> used;     /* the occupied slots in insertion order */
+    uint64_t mask;
+    size_t capacity;
+
+    count_map(size_t cap = 1024) {
+        capacity = cap;
+        size_t slots = 1;
+        while(slots < 2 * cap) slots <<= 1;
+        keys.assign(slots, COUNT_EMPTY);
+        counts.assign(slots, 0);
+        used.reserve(cap);
+        mask = slots - 1;
+    }
+
+    void add(uint64_t key, uint32_t cnt = 1) {
+        uint64_t h = rand_hash(key) & mask;
+        while(keys[h] != COUNT_EMPTY && keys[h] != key) h = (h + 1) & mask;
+        if(keys[h] == COUNT_EMPTY) {
+            keys[h] = key;
+            counts[h] = 0;
+            used.push_back(h);
+        }
+        counts[h] += cnt;
+    }
+
+    size_t size() const { return used.size(); }
+    bool full() const { return used.size() >= capacity; }
+
+    /** call `callback(key, count)` for every key and empty the map */
+    template<typename callback_t>
+    void drain(callback_t callback) {
+        for(uint32_t h : used) {
+            callback(keys[h], counts[h]);
+            keys[h] = COUNT_EMPTY;
+        }
+        used.clear();
+    }
+};
+
+#endif
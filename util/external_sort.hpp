@@ -0,0 +1,162 @@
+#ifndef _GRAPH_EXTERNAL_SORT_H_
+#define _GRAPH_EXTERNAL_SORT_H_
+
+#include <string>
+#include <vector>
+#include <queue>
+#include <algorithm>
+#include <omp.h>
+#include "util/util.hpp"
+#include "util/io.hpp"
+#include "logger/logger.hpp"
+
+/**
+ * This file defines the bounded memory external sort. Records are collected into a run buffer of
+ * `memory` bytes, every full buffer is sorted on all cores and spilled to a run file, and `merge`
+ * streams the records in order with a k-way merge of the runs. If everything fits into one buffer,
+ * nothing is written to disk.
+ */
+
+/** sort [first, last) on all cores: sort one slice per thread, then merge the slices pairwise */
+template<typename T, typename compare_t>
+void parallel_sort(T *first, T *last, compare_t cmp) {
+    size_t n = last - first;
+    int nparts = omp_get_max_threads();
+    if(n < 65536 || nparts <= 1) {
+        std::sort(first, last, cmp);
+        return;
+    }
+
+    std::vector<size_t> bounds(nparts + 1);
+    for(int p = 0; p <= nparts; p++) bounds[p] = n * p / nparts;
+
+    #pragma omp parallel for schedule(static, 1)
+    for(int p = 0; p < nparts; p++) {
+        std::sort(first + bounds[p], first + bounds[p + 1], cmp);
+    }
+
+    for(int width = 1; width < nparts; width *= 2) {
+        #pragma omp parallel for schedule(dynamic, 1)
+        for(int p = 0; p < nparts - width; p += 2 * width) {
+            int q = min_value(p + 2 * width, nparts);
+            std::inplace_merge(first + bounds[p], first + bounds[p + width], first + bounds[q], cmp);
+        }
+    }
+}
+
+template<typename T, typename compare_t>
+class external_sorter {
+private:
+    std::string prefix;                 /* run files are named `prefix_<i>.run` */
+    size_t capacity;                    /* records of one run */
+    compare_t cmp;
+    std::vector<T> buffer;
+    std::vector<std::string> runs;
+    size_t nrecords;
+
+    /** buffered sequential reader of one run file */
+    struct run_reader {
+        int fd;
+        off_t off;
+        std::vector<T> buf;
+        size_t pos, len;
+
+        bool fill() {
+            ssize_t ret = pread(fd, &buf[0], buf.size() * sizeof(T), off);
+            assert(ret >= 0 && ret % sizeof(T) == 0);
+            off += ret;
+            pos = 0;
+            len = ret / sizeof(T);
+            return len > 0;
+        }
+
+        bool next(T &rec) {
+            if(pos == len && !fill()) return false;
+            rec = buf[pos++];
+            return true;
+        }
+    };
+
+    void spill_run() {
+        parallel_sort(buffer.data(), buffer.data() + buffer.size(), cmp);
+        std::string name = prefix + "_" + std::to_string(runs.size()) + ".run";
+        int fd = open(name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+        assert(fd >= 0);
+        dump_block_range(fd, &buffer[0], buffer.size(), 0);
+        close(fd);
+        runs.push_back(name);
+        logstream(LOG_DEBUG) << "external sort : spill run " << name << ", " << buffer.size() << " records" << std::endl;
+        buffer.clear();
+    }
+
+public:
+    external_sorter(const std::string& run_prefix, size_t memory, compare_t compare = compare_t()) : cmp(compare) {
+        prefix   = run_prefix;
+        capacity = max_value(memory / sizeof(T), (size_t)1);
+        nrecords = 0;
+        buffer.reserve(capacity);
+    }
+
+    ~external_sorter() {
+        for(const auto & name : runs) test_delete(name);
+    }
+
+    void add(const T &rec) {
+        buffer.push_back(rec);
+        nrecords++;
+        if(buffer.size() == capacity) spill_run();
+    }
+
+    size_t size() const { return nrecords; }
+
+    /** call `callback(rec)` for all records in sorted order, the sorter is empty afterwards */
+    template<typename callback_t>
+    void merge(callback_t callback) {
+        if(runs.empty()) {
+            parallel_sort(buffer.data(), buffer.data() + buffer.size(), cmp);
+            for(const auto & rec : buffer) callback(rec);
+            buffer.clear();
+            nrecords = 0;
+            return;
+        }
+        if(!buffer.empty()) spill_run();
+        std::vector<T>().swap(buffer);
+
+        /* the run buffer memory is shared by the readers of all runs */
+        size_t nruns = runs.size();
+        size_t per_run = max_value(capacity / nruns, (size_t)1024);
+        std::vector<run_reader> readers(nruns);
+        for(size_t r = 0; r < nruns; r++) {
+            readers[r].fd = open(runs[r].c_str(), O_RDONLY);
+            assert(readers[r].fd >= 0);
+            readers[r].off = 0;
+            readers[r].buf.resize(per_run);
+            readers[r].pos = readers[r].len = 0;
+        }
+        logstream(LOG_INFO) << "external sort : merge " << nruns << " runs, " << nrecords << " records" << std::endl;
+
+        typedef std::pair<T, size_t> head_t;
+        auto greater = [this](const head_t& a, const head_t& b) { return cmp(b.first, a.first); };
+        std::priority_queue<head_t, std::vector<head_t>, decltype(greater)> heads(greater);
+        T rec;
+        for(size_t r = 0; r < nruns; r++) {
+            if(readers[r].next(rec)) heads.push(std::make_pair(rec, r));
+        }
+        while(!heads.empty()) {
+            head_t top = heads.top();
+            heads.pop();
+            callback(top.first);
+            if(readers[top.second].next(rec)) heads.push(std::make_pair(rec, top.second));
+        }
+
+        for(size_t r = 0; r < nruns; r++) {
+            close(readers[r].fd);
+            test_delete(runs[r]);
+        }
+        runs.clear();
+        nrecords = 0;
+        buffer.reserve(capacity);
+    }
+};
+
+#endif
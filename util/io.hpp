@@ -40,7 +40,7 @@ void load_block_range(int fd, T *buf, size_t count, off_t off) {
     size_t total = sizeof(T) * count; /* the bytes that need to read */
     char* bufptr = (char *)buf;
     while(nbr < total) {
-        size_t ret = pread(fd, bufptr, total - nbr, off);
+        ssize_t ret = pread(fd, bufptr, total - nbr, off);
         assert(ret > 0);
         bufptr += ret;
         nbr += ret;
@@ -54,7 +54,7 @@ void dump_block_range(int fd, T *buf, size_t count, off_t off) {
     size_t total = sizeof(T) * count;
     char *bufptr = (char*) buf;
     while(nbw < total) {
-        size_t ret = pwrite(fd, bufptr, total - nbw, off);
+        ssize_t ret = pwrite(fd, bufptr, total - nbw, off);
         assert(ret > 0);
         bufptr += ret;
         nbw += ret;
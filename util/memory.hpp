@@ -0,0 +1,56 @@
+#ifndef _GRAPH_MEMORY_H_
+#define _GRAPH_MEMORY_H_
+
+#include <string>
+#include <fstream>
+#include <unistd.h>
+#include "api/constants.hpp"
+#include "logger/logger.hpp"
+#include "util.hpp"
+
+/** memory
+ *
+ * This file detects the memory a run may use. The available memory is `MemAvailable` of `/proc/meminfo`,
+ * bounded by the cgroup v2 limit of the process when it runs in a container, so the same binary picks
+ * its sizes on a laptop and on a large server.
+ */
+
+/** the bytes of memory available to this process, 0 if they cannot be found */
+inline size_t available_memory() {
+    size_t avail = 0;
+    std::ifstream meminfo("/proc/meminfo");
+    std::string key;
+    size_t kb;
+    while(meminfo >> key >> kb) {
+        if(key == "MemAvailable:") {
+            avail = kb * 1024;
+            break;
+        }
+        meminfo.ignore(256, '\n');
+    }
+    if(avail == 0) avail = (size_t)sysconf(_SC_AVPHYS_PAGES) * (size_t)sysconf(_SC_PAGESIZE);
+
+    /* `max` in memory.max means no limit and fails the read */
+    std::ifstream limit("/sys/fs/cgroup/memory.max"), current("/sys/fs/cgroup/memory.current");
+    size_t max_bytes, used_bytes = 0;
+    if(limit >> max_bytes) {
+        current >> used_bytes;
+        size_t left = max_bytes > used_bytes ? max_bytes - used_bytes : 0;
+        avail = avail ? min_value(avail, left) : left;
+    }
+    return avail;
+}
+
+/** the memory budget of a run: `mb` megabytes when given, otherwise `MEMORY_BUDGET_PERCENT` of the available memory */
+inline size_t memory_budget(size_t mb) {
+    if(mb > 0) return mb << 20;
+    size_t avail = available_memory();
+    if(avail == 0) {
+        logstream(LOG_WARNING) << "cannot detect the available memory, the budget is " << (MEMORY_CACHE >> 20) << "MB" << std::endl;
+        return MEMORY_CACHE;
+    }
+    logstream(LOG_INFO) << "available memory : " << (avail >> 20) << "MB, budget : " << MEMORY_BUDGET_PERCENT << "%" << std::endl;
+    return avail / 100 * MEMORY_BUDGET_PERCENT;
+}
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef _GRAPH_RANDOM_H_
+#define _GRAPH_RANDOM_H_
+
+#include <stdint.h>
+
+/** random
+ *
+ * This file defines the lock-free random generators used on the walk hot path.
+ * A generator is seeded from a (run seed, key, counter) triple, e.g. (seed, walk id, hop),
+ * so the samples a walk draws do not depend on the thread which executes it, and a run
+ * is reproducible given the same seed.
+ *
+ * `counter_engine` : counter-based stream, the i-th output is a bijective hash of `state + i * gamma`
+ * `xoshiro_engine` : xoshiro256** stream, longer period but 32 bytes of state
+ *
+ * Define `RAND_XOSHIRO` to select the xoshiro engine for `rand_t`.
+ */
+
+#define RAND_GAMMA 0x9e3779b97f4a7c15ULL
+
+inline uint64_t rand_hash(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/** mix the (seed, key, counter) triple into one 64-bit stream start point */
+inline uint64_t rand_mix(uint64_t seed, uint64_t key, uint64_t ctr) {
+    return rand_hash(rand_hash(seed + RAND_GAMMA) ^ rand_hash(key * RAND_GAMMA + ctr));
+}
+
+class counter_engine {
+private:
+    uint64_t state;
+public:
+    counter_engine(uint64_t seed = 0, uint64_t key = 0, uint64_t ctr = 0) {
+        this->seed(seed, key, ctr);
+    }
+
+    void seed(uint64_t seed, uint64_t key, uint64_t ctr) {
+        state = rand_mix(seed, key, ctr);
+    }
+
+    uint64_t next() {
+        state += RAND_GAMMA;
+        return rand_hash(state);
+    }
+};
+
+class xoshiro_engine {
+private:
+    uint64_t s[4];
+
+    static uint64_t rotl(uint64_t x, int k) {
+        return (x << k) | (x >> (64 - k));
+    }
+public:
+    xoshiro_engine(uint64_t seed = 0, uint64_t key = 0, uint64_t ctr = 0) {
+        this->seed(seed, key, ctr);
+    }
+
+    void seed(uint64_t seed, uint64_t key, uint64_t ctr) {
+        uint64_t x = rand_mix(seed, key, ctr);
+        for(int i = 0; i < 4; i++) {
+            x += RAND_GAMMA;
+            s[i] = rand_hash(x);
+        }
+    }
+
+    uint64_t next() {
+        uint64_t result = rotl(s[1] * 5, 7) * 9;
+        uint64_t t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotl(s[3], 45);
+        return result;
+    }
+};
+
+/** the sampling interface on top of an engine */
+template<typename engine_t>
+class graph_rand : public engine_t {
+public:
+    graph_rand(uint64_t seed = 0, uint64_t key = 0, uint64_t ctr = 0) : engine_t(seed, key, ctr) { }
+
+    /** uniform integer in [0, n), multiply-shift reduction instead of modulo */
+    uint64_t gen(uint64_t n) {
+        return (uint64_t)(((unsigned __int128)this->next() * n) >> 64);
+    }
+
+    /** uniform float in [0, 1) */
+    float gen_float() {
+        return (float)(this->next() >> 40) * (1.0f / 16777216.0f);
+    }
+};
+
+#ifdef RAND_XOSHIRO
+typedef graph_rand<xoshiro_engine> rand_t;
+#else
+typedef graph_rand<counter_engine> rand_t;
+#endif
+
+#endif
@@ -0,0 +1,161 @@
+#ifndef _GRAPH_URING_H_
+#define _GRAPH_URING_H_
+
+/** uring
+ *
+ * This file defines a minimal io_uring submission/completion ring on top of the raw system calls,
+ * so the io_uring driver does not need liburing. `HAVE_IO_URING` is defined when the kernel
+ * header is present; whether the running kernel allows io_uring is only known after `setup`.
+ */
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define HAVE_IO_URING
+#endif
+#endif
+
+#ifdef HAVE_IO_URING
+
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+/* <linux/fs.h> defines its own `BLOCK_SIZE`, keep the one of api/constants.hpp */
+#pragma push_macro("BLOCK_SIZE")
+#include <linux/io_uring.h>
+#undef BLOCK_SIZE
+#pragma pop_macro("BLOCK_SIZE")
+
+class io_ring {
+private:
+    int ring_fd;
+    unsigned to_submit;              /* sqes queued since the last submit */
+
+    /* submission ring */
+    void *sq_ptr;
+    size_t sq_len;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    io_uring_sqe *sqes;
+    size_t sqes_len;
+
+    /* completion ring */
+    void *cq_ptr;
+    size_t cq_len;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    io_uring_cqe *cqes;
+
+    unsigned entries;
+
+    int enter(unsigned submit, unsigned wait_nr, unsigned flags) {
+        return (int)syscall(__NR_io_uring_enter, ring_fd, submit, wait_nr, flags, NULL, 0);
+    }
+
+public:
+    io_ring() {
+        ring_fd = -1;
+        to_submit = 0;
+        sq_ptr = cq_ptr = NULL;
+        sqes = NULL;
+        entries = 0;
+    }
+
+    ~io_ring() { this->destroy(); }
+
+    /** create a ring with `depth` entries, return false if the kernel does not allow io_uring */
+    bool setup(unsigned depth) {
+        io_uring_params p;
+        memset(&p, 0, sizeof(p));
+        ring_fd = (int)syscall(__NR_io_uring_setup, depth, &p);
+        if(ring_fd < 0) return false;
+
+        sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cq_len = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+        if(single) sq_len = cq_len = (sq_len > cq_len ? sq_len : cq_len);
+
+        sq_ptr = mmap(NULL, sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+        if(sq_ptr == MAP_FAILED) { sq_ptr = NULL; this->destroy(); return false; }
+        if(single) {
+            cq_ptr = sq_ptr;
+        } else {
+            cq_ptr = mmap(NULL, cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+            if(cq_ptr == MAP_FAILED) { cq_ptr = NULL; this->destroy(); return false; }
+        }
+        sqes_len = p.sq_entries * sizeof(io_uring_sqe);
+        sqes = (io_uring_sqe*)mmap(NULL, sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+        if(sqes == MAP_FAILED) { sqes = NULL; this->destroy(); return false; }
+
+        char *sq = (char*)sq_ptr, *cq = (char*)cq_ptr;
+        sq_head  = (unsigned*)(sq + p.sq_off.head);
+        sq_tail  = (unsigned*)(sq + p.sq_off.tail);
+        sq_mask  = (unsigned*)(sq + p.sq_off.ring_mask);
+        sq_array = (unsigned*)(sq + p.sq_off.array);
+        cq_head  = (unsigned*)(cq + p.cq_off.head);
+        cq_tail  = (unsigned*)(cq + p.cq_off.tail);
+        cq_mask  = (unsigned*)(cq + p.cq_off.ring_mask);
+        cqes     = (io_uring_cqe*)(cq + p.cq_off.cqes);
+        entries  = p.sq_entries;
+        return true;
+    }
+
+    void destroy() {
+        if(sqes) munmap(sqes, sqes_len);
+        if(cq_ptr && cq_ptr != sq_ptr) munmap(cq_ptr, cq_len);
+        if(sq_ptr) munmap(sq_ptr, sq_len);
+        if(ring_fd >= 0) close(ring_fd);
+        sqes = NULL;
+        sq_ptr = cq_ptr = NULL;
+        ring_fd = -1;
+    }
+
+    unsigned depth() const { return entries; }
+
+    /** queue one read or write, return false if the submission ring is full */
+    bool prepare(int opcode, int fd, void *buf, unsigned len, off_t off, uint64_t user_data) {
+        unsigned tail = *sq_tail;
+        unsigned head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+        if(tail - head >= entries) return false;
+
+        unsigned idx = tail & *sq_mask;
+        io_uring_sqe *sqe = &sqes[idx];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode    = (uint8_t)opcode;
+        sqe->fd        = fd;
+        sqe->addr      = (uint64_t)(uintptr_t)buf;
+        sqe->len       = len;
+        sqe->off       = (uint64_t)off;
+        sqe->user_data = user_data;
+        sq_array[idx]  = idx;
+        __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+        to_submit++;
+        return true;
+    }
+
+    /** submit the queued entries and wait at least `wait_nr` completions */
+    int submit(unsigned wait_nr = 0) {
+        int ret;
+        do {
+            ret = enter(to_submit, wait_nr, wait_nr > 0 ? IORING_ENTER_GETEVENTS : 0);
+        } while(ret < 0 && errno == EINTR);
+        if(ret > 0) to_submit -= (unsigned)ret;
+        return ret;
+    }
+
+    /** pop one completion, return false if there is none */
+    bool reap(uint64_t &user_data, int &res) {
+        unsigned head = *cq_head;
+        unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+        if(head == tail) return false;
+        io_uring_cqe *cqe = &cqes[head & *cq_mask];
+        user_data = cqe->user_data;
+        res = cqe->res;
+        __atomic_store_n(cq_head, head + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+};
+
+#endif
+
+#endif
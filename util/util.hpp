@@ -3,11 +3,14 @@
 
 #include <string>
 #include <sstream>
+#include <vector>
+#include <algorithm>
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <cstdio>
+#include "api/types.hpp"
 
 // for windows mkdir
 #ifdef _WIN32
@@ -83,18 +86,56 @@ inline std::string get_edge_blocks_name(std::string const & base_name, size_t bl
     return concatnate_name(base_name, blocksize / (1024 * 1024)) + "MB.edge.blocks";
 }
 
+inline std::string get_compressed_csr_name(std::string const & base_name, int fnum) {
+    return concatnate_name(base_name, fnum) + ".zcsr";
+}
+
+/** the byte offset of each block in the compressed csr file, depends on the block split */
+inline std::string get_compressed_index_name(std::string const & base_name, size_t blocksize) {
+    return concatnate_name(base_name, blocksize / (1024 * 1024)) + "MB.zidx";
+}
+
 inline std::string get_ratio_name(std::string const & base_name, int fnum) {
     return concatnate_name(base_name, fnum) + ".rat";
 }
 
-inline std::string get_walk_name(std::string const & base_name, bid_t blk) {
-    return concatnate_name(base_name, blk) + ".walk";
+/** the segments of the spilled walks of all blocks */
+inline std::string get_spill_name(std::string const & base_name) {
+    return base_name + ".spill";
 }
 
 inline std::string get_meta_name(std::string const & base_name) {
     return base_name + ".meta";
 }
 
+/** the hub block: the sorted hub ids, their adjacency offsets and their adjacency */
+inline std::string get_hub_name(std::string const & base_name) {
+    return base_name + ".hub";
+}
+
+inline std::string get_hub_beg_pos_name(std::string const & base_name) {
+    return base_name + ".hbeg";
+}
+
+inline std::string get_hub_csr_name(std::string const & base_name) {
+    return base_name + ".hcsr";
+}
+
+/** the original id of each vertex of a reordered graph */
+inline std::string get_perm_name(std::string const & base_name) {
+    return base_name + ".perm";
+}
+
+/** the path records written by thread `tid` */
+inline std::string get_path_fragment_name(std::string const & base_name, tid_t tid) {
+    return concatnate_name(base_name, tid) + ".path";
+}
+
+/** the personalized PageRank visit counts written by thread `tid` */
+inline std::string get_visit_name(std::string const & base_name, tid_t tid) {
+    return concatnate_name(base_name, tid) + ".visit";
+}
+
 /** test a file existence */
 inline bool test_exists(const std::string & filename) {
     struct stat buffer;
@@ -113,11 +154,58 @@ inline bool test_delete(const std::string & filename) {
 /** given data vertex, return the block that the vertex belongs to */
 bid_t get_block(std::vector<vid_t>& vblocks, vid_t v) {
     bid_t nblocks = vblocks.size() - 1;
-    for(bid_t p = 0; p < nblocks; p++) {
-        if(v < vblocks[p+1]) return p;
+    if(v >= vblocks[nblocks]) return nblocks;
+    return std::upper_bound(vblocks.begin() + 1, vblocks.end(), v) - vblocks.begin() - 1;
+}
+
+/**
+ * vertex to block lookup index built from the `.vert.blocks` split points.
+ * `bounds`  : the block split points, block `p` holds vertices [ bounds[p], bounds[p+1] )
+ * `buckets` : bucket `b` covers vertices [ b << shift, (b + 1) << shift ), and records the block of its
+ *             first vertex, so a lookup only binary searches the few blocks overlapping one bucket.
+ */
+class block_index {
+private:
+    std::vector<vid_t> bounds;
+    std::vector<bid_t> buckets;
+    bid_t nblocks;
+    vid_t nbuckets;
+    int shift;
+
+public:
+    block_index() { nblocks = 0, nbuckets = 0, shift = 0; }
+    block_index(const std::vector<vid_t>& vblocks) { build(vblocks); }
+
+    void build(const std::vector<vid_t>& vblocks) {
+        bounds  = vblocks;
+        nblocks = bounds.size() - 1;
+
+        /* about four buckets per block, so a bucket mostly overlaps one or two blocks */
+        uint64_t nverts = bounds[nblocks];
+        shift = 0;
+        while((nverts >> shift) > 4 * (uint64_t)nblocks) shift++;
+        nbuckets = (vid_t)(nverts >> shift) + 1;
+
+        buckets.resize(nbuckets + 1);
+        bid_t blk = 0;
+        for(vid_t b = 0; b < nbuckets; b++) {
+            uint64_t first = (uint64_t)b << shift;
+            while(blk < nblocks && first >= bounds[blk + 1]) blk++;
+            buckets[b] = blk;
+        }
+        buckets[nbuckets] = nblocks;
     }
-    return nblocks;
-}
+
+    bid_t get_block(vid_t v) const {
+        if(v >= bounds[nblocks]) return nblocks;
+        vid_t b = v >> shift;
+        bid_t lo = buckets[b], hi = min_value(buckets[b + 1], nblocks - 1);
+        if(lo == hi) return lo;
+        return std::upper_bound(bounds.begin() + lo + 1, bounds.begin() + hi + 1, v) - bounds.begin() - 1;
+    }
+
+    bid_t size() const { return nblocks; }
+};
 
 std::string get_path_name(const std::string& s) {
     char sep = '/';